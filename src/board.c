@@ -1,22 +1,31 @@
+#include <allegro5/allegro_primitives.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "./board.h"
+#include "./profile.h"
 #include "./resources.h"
 #include "./utils.h"
 
 /**
- * Plansza
- * Ponieważ na planszy można ułożyć 72 płytki, a potencjalnie mogą one być ułożone w jednym rzędzie,
- * musi ona zmieścić 72 płytki w każdą stronę od środka.
- * Płytki są trzymane w tablicy, a plansza przechowuje jedynie wskaźniki. Ułatwia to sprawdzanie, czy w danym polu
- * leży płytka oraz oszczędza miejsce.
+ * Plansza, na której działają funkcje modułu (zob. `board_use()`). Stan planszy jest osobny dla każdego wątku,
+ * dzięki czemu można rozgrywać kilka gier równolegle.
  */
-static struct Board
-{
-  Tile tiles[TILE_COUNT];
-  Tile *grid[BOARD_SIZE + 1][BOARD_SIZE + 1];
-  size_t tile_count;
-} board;
+static _Thread_local Board board_own;
+static _Thread_local Board *board_active;
+#define board (*(board_active ? board_active : &board_own))
+
+/** Tymczasowa płytka (zob. `board_tile_tmp()`), nie należy do stanu planszy */
+static _Thread_local Tile *tile_tmp;
+static _Thread_local int tile_tmp_x, tile_tmp_y;
+
+/** Zwiększany przy każdej zmianie wyłożonych płytek i podwładnych, unieważnia warstwę planszy */
+static _Thread_local unsigned int board_version;
+
+#ifdef BOT_STATS
+_Thread_local BfsStats bfs_stats;
+#endif
 
 // Helpers
 
@@ -27,12 +36,22 @@ static struct Board
 #define TILE_MATCHES_V(UP, DOWN) TILE_MATCHES(UP, DOWN, 6, 0)
 #define TILE_MATCHES_H(LEFT, RIGHT) TILE_MATCHES(LEFT, RIGHT, 3, 9)
 
-#define TILE_AT(X, Y) board.grid[Y][X]
+#define TILE_AT(X, Y) tile_at(&board, board.grid[Y][X])
+
+static inline Tile *tile_at(Board *b, uint8_t idx)
+{
+  return idx == BOARD_TILE_TMP ? tile_tmp : idx ? &b->tiles[idx - 1] : NULL;
+}
 
 // BFS
 
-#define IS_VISITED(X, Y, ID) (bool)(vis[Y][X] & (1 << (ID)))
-#define MARK_VISITED(X, Y, ID) vis[Y][X] |= (1 << (ID))
+/**
+ * Odwiedzone fragmenty płytek. Zamiast czyścić całą tablicę przed każdym przejściem, każde przejście ma swój numer,
+ * a pole jest czyszczone dopiero przy pierwszym odwiedzeniu w danym przejściu
+ */
+#define VISITED(X, Y) (vis_epoch[Y][X] == epoch ? vis[Y][X] : 0)
+#define IS_VISITED(X, Y, ID) (bool)(VISITED(X, Y) & (1 << (ID)))
+#define MARK_VISITED(X, Y, ID) vis[Y][X] = VISITED(X, Y) | (1 << (ID)), vis_epoch[Y][X] = epoch
 
 #define BOARD_BFS_HELPER(T, X, Y, ID, AI, BI)                                                                          \
   {                                                                                                                    \
@@ -69,12 +88,19 @@ bool board_bfs(int x, int y, TilePos pos, board_bfs_cb cb, void *data)
   if (!t)
     return true;
 
-  static int QX[BOARD_SIZE];
-  static int QY[BOARD_SIZE];
-  static TileId QP[BOARD_SIZE];
-  static int vis[BOARD_SIZE][BOARD_SIZE];
+  static _Thread_local int QX[BOARD_SIZE];
+  static _Thread_local int QY[BOARD_SIZE];
+  static _Thread_local TileId QP[BOARD_SIZE];
+  static _Thread_local int vis[BOARD_SIZE][BOARD_SIZE];
+  static _Thread_local uint32_t vis_epoch[BOARD_SIZE][BOARD_SIZE];
+  static _Thread_local uint32_t epoch;
 
-  memset(vis, 0, sizeof(vis));
+  if (++epoch == 0)
+  {
+    memset(vis_epoch, 0, sizeof(vis_epoch));
+    epoch = 1;
+  }
+  STATS(bfs_stats.calls++);
 
   int qf = 0, qs = 1;
   bool completed = true;
@@ -92,8 +118,13 @@ bool board_bfs(int x, int y, TilePos pos, board_bfs_cb cb, void *data)
     qf = (qf + 1) % BOARD_SIZE;
     qs--;
 
+    // Ten sam fragment mógł trafić do kolejki kilka razy, zanim został odwiedzony
+    if (IS_VISITED(x, y, id))
+      continue;
+
+    STATS(bfs_stats.cells++);
     if (cb)
-      cb(x, y, pos, vis[y][x], data);
+      cb(x, y, pos, VISITED(x, y), data);
 
     MARK_VISITED(x, y, id);
 
@@ -129,7 +160,10 @@ static void board_collect_meeple_cb(int x, int y, TilePos pos, bool revisit, Col
   data->meeple_pos[t->meeple.color][1] = y;
 
   if (data->remove)
+  {
     t->meeple.color = MeepleNone;
+    board_version++;
+  }
 }
 
 void board_collect_meeple(int x, int y, TilePos pos, bool remove, MeepleCounts meeple, CollectMeeplePos meeple_pos)
@@ -172,23 +206,23 @@ Tile *board_tile_get(int x, int y)
 
 bool board_tile_matches(Tile *t, int x, int y)
 {
-  if (TILE_AT(x, y))
+  Board *b = &board;
+  if (b->grid[y][x])
     return false;
 
-  Tile *up = board.grid[y - 1][x];
-  Tile *down = board.grid[y + 1][x];
-  Tile *left = board.grid[y][x - 1];
-  Tile *right = board.grid[y][x + 1];
-
-  if (!up && !down && !left && !right)
+  // Funkcja jest wywoływana dla każdego pola planszy, więc najpierw sprawdzane są same numery płytek
+  uint8_t up = b->grid[y - 1][x], down = b->grid[y + 1][x], left = b->grid[y][x - 1], right = b->grid[y][x + 1];
+  if (!(up | down | left | right))
     return false;
-  if (up && !TILE_MATCHES_V(up, t))
+
+  Tile *tile;
+  if (up && (tile = tile_at(b, up), !TILE_MATCHES_V(tile, t)))
     return false;
-  if (down && !TILE_MATCHES_V(t, down))
+  if (down && (tile = tile_at(b, down), !TILE_MATCHES_V(t, tile)))
     return false;
-  if (left && !TILE_MATCHES_H(left, t))
+  if (left && (tile = tile_at(b, left), !TILE_MATCHES_H(tile, t)))
     return false;
-  if (right && !TILE_MATCHES_H(t, right))
+  if (right && (tile = tile_at(b, right), !TILE_MATCHES_H(t, tile)))
     return false;
 
   return true;
@@ -212,12 +246,18 @@ void board_tile_place(Tile *tile, int x, int y)
 {
   size_t idx = board.tile_count++;
   board.tiles[idx] = *tile;
-  TILE_AT(x, y) = &board.tiles[idx];
+  board.pos[idx][0] = x;
+  board.pos[idx][1] = y;
+  board.grid[y][x] = idx + 1;
+  board_version++;
 }
 
 void board_tile_tmp(Tile *tile, int x, int y)
 {
-  TILE_AT(x, y) = tile;
+  tile_tmp = tile;
+  tile_tmp_x = x;
+  tile_tmp_y = y;
+  board.grid[y][x] = tile ? BOARD_TILE_TMP : 0;
 }
 
 // Meeple methods
@@ -227,11 +267,12 @@ void board_meeple_place(Meeple *m, int x, int y)
   Tile *t = TILE_AT(x, y);
   if (t)
     t->meeple = *m;
+  board_version++;
 }
 
 bool board_meeple_matches(Meeple *m, int x, int y)
 {
-  static MeepleCounts meeple;
+  static _Thread_local MeepleCounts meeple;
 
   Tile *t = TILE_AT(x, y);
   if (!t)
@@ -250,8 +291,8 @@ void board_meeple_valid(Meeple *m, int x, int y, MeepleValidPos pos)
 {
   Tile *t = TILE_AT(x, y);
 
-  static bool checked[13];
-  static bool valid[13];
+  static _Thread_local bool checked[13];
+  static _Thread_local bool valid[13];
   memset(checked, false, sizeof(checked));
   memset(valid, true, sizeof(checked));
 
@@ -277,32 +318,131 @@ void board_meeple_valid(Meeple *m, int x, int y, MeepleValidPos pos)
 
 // Init and deinit
 
+static void board_layer_destroy();
+
 void board_init()
 {
   board.tile_count = 0;
-
-  for (int y = 0; y < BOARD_SIZE; y++)
-    for (int x = 0; x < BOARD_SIZE; x++)
-      TILE_AT(x, y) = NULL;
+  memset(board.grid, 0, sizeof(board.grid));
+  board_version++;
 }
 
 void board_deinit()
 {
   memset(&board, 0, sizeof(board));
+  board_version++;
+  board_layer_destroy();
+}
+
+void board_use(Board *b)
+{
+  board_active = b;
+  board_version++;
+}
+
+// Snapshots
+
+void board_save(Board *b)
+{
+  *b = board;
+
+  // Tymczasowa płytka nie należy do stanu planszy, a wskaźnik na nią nie przetrwa wczytania w innym wątku
+  if (b->grid[tile_tmp_y][tile_tmp_x] == BOARD_TILE_TMP)
+    b->grid[tile_tmp_y][tile_tmp_x] = 0;
+}
+
+void board_load(const Board *b)
+{
+  board = *b;
+  board_version++;
 }
 
 // Rendering
 
+/**
+ * Płytki, podwładni i bloki tła są rysowani przez `al_draw_prim()`, wiele naraz - każdy prostokąt to 2 trójkąty.
+ * Współrzędne tekstury (w pikselach poziomu 0 atlasu `board.png`) są wyliczone raz dla każdej płytki
+ * i każdego obrotu: rogi TL, TR, BR, BL
+ */
+#define QUAD_VERTICES 6
+typedef float QuadUV[4][2];
+
+static QuadUV tile_uv[24][4];
+
+static void tile_uv_init()
+{
+  static bool ready = false;
+  if (ready)
+    return;
+
+  for (int i = 0; i < 24; i++)
+  {
+    float u0 = BMP_TILES_S * (i / 8), v0 = BMP_TILES_S * (i % 8);
+    QuadUV corners = {{u0, v0}, {u0 + BMP_TILES_S, v0}, {u0 + BMP_TILES_S, v0 + BMP_TILES_S}, {u0, v0 + BMP_TILES_S}};
+
+    // Obrót o r * 90 stopni zgodnie z ruchem wskazówek zegara: w rogu k na ekranie jest róg k-r bitmapy
+    for (int r = 0; r < 4; r++)
+      for (int k = 0; k < 4; k++)
+      {
+        tile_uv[i][r][k][0] = corners[(k - r + 4) % 4][0];
+        tile_uv[i][r][k][1] = corners[(k - r + 4) % 4][1];
+      }
+  }
+  ready = true;
+}
+
+/** Środki pozycji podwładnych na płytce, jako ułamek rozmiaru płytki */
+static const float MP_X[] = {.30, .50, .70, .85, .85, .85, .70, .50, .30, .15, .15, .15, .50};
+static const float MP_Y[] = {.15, .15, .15, .30, .50, .70, .85, .85, .85, .70, .50, .30, .50};
+
+static void meeple_uv(MeepleColor color, QuadUV uv)
+{
+  float u = BMP_MEEPLE_S * (color + 5);
+  QuadUV corners = {{u, 0}, {u + BMP_MEEPLE_S, 0}, {u + BMP_MEEPLE_S, BMP_MEEPLE_S}, {u, BMP_MEEPLE_S}};
+  memcpy(uv, corners, sizeof(QuadUV));
+}
+
+/** Dopisuje prostokąt do tablicy wierzchołków. `level` - poziom atlasu, na którym leży tekstura */
+static ALLEGRO_VERTEX *quad_push(ALLEGRO_VERTEX *v, float x, float y, float w, float h, QuadUV uv, int level,
+                                 ALLEGRO_COLOR tint)
+{
+  static const int ORDER[QUAD_VERTICES] = {0, 1, 2, 0, 2, 3};
+  float corners[4][2] = {{x, y}, {x + w, y}, {x + w, y + h}, {x, y + h}};
+  float uv_s = 1.0 / (1 << level);
+
+  for (int i = 0; i < QUAD_VERTICES; i++)
+    *v++ = (ALLEGRO_VERTEX){.x = corners[ORDER[i]][0],
+                            .y = corners[ORDER[i]][1],
+                            .z = 0,
+                            .u = uv[ORDER[i]][0] * uv_s,
+                            .v = uv[ORDER[i]][1] * uv_s,
+                            .color = tint};
+  return v;
+}
+
+/** Rozmiar `s` w pikselach ekranu, z uwzględnieniem skalowania obrazu */
+static float board_px(float s)
+{
+  return s * al_get_current_transform()->m[0][0];
+}
+
 void tile_render(Tile *t, float x, float y, float s, RenderFlag flags)
 {
   ALLEGRO_COLOR tint = flags & RenderFlagFaded ? al_map_rgba_f(0.6, 0.6, 0.6, 1) : al_map_rgb_f(1, 1, 1);
+  int level = res_atlas_level(board_px(s));
 
-  al_draw_tinted_scaled_rotated_bitmap(bitmaps.tiles[t->bitmap], tint, BMP_TILES_S / 2, BMP_TILES_S / 2, x, y,
-                                       s / BMP_TILES_S, s / BMP_TILES_S, t->rot * ALLEGRO_PI / 2, 0);
+  ALLEGRO_VERTEX v[QUAD_VERTICES];
+  tile_uv_init();
+  quad_push(v, x - s / 2, y - s / 2, s, s, tile_uv[t->bitmap][t->rot], level, tint);
+  al_draw_prim(v, NULL, bitmaps.atlas[level], 0, QUAD_VERTICES, ALLEGRO_PRIM_TRIANGLE_LIST);
+  PROFILE_DRAW(1);
 
   if (flags & RenderFlagHighlight)
+  {
     al_draw_scaled_bitmap(bitmaps.tile_highlight, 0, 0, BMP_TILES_S * 2, BMP_TILES_S * 2, x - s, y - s, 2 * s, 2 * s,
                           0);
+    PROFILE_DRAW(1);
+  }
 
   if (t->meeple.color != MeepleNone)
     meeple_render(&t->meeple, x, y, s, 0);
@@ -310,29 +450,149 @@ void tile_render(Tile *t, float x, float y, float s, RenderFlag flags)
 
 void meeple_render(Meeple *m, float x, float y, float s, RenderFlag flags)
 {
-  float MP_X[] = {.30, .50, .70, .85, .85, .85, .70, .50, .30, .15, .15, .15, .50};
-  float MP_Y[] = {.15, .15, .15, .30, .50, .70, .85, .85, .85, .70, .50, .30, .50};
-
   float ms = s / 3;
 
   ALLEGRO_COLOR tint = flags & RenderFlagFaded ? al_map_rgba_f(0.4, 0.4, 0.4, 0.6) : al_map_rgb_f(1, 1, 1);
+  int level = res_atlas_level(board_px(s));
+
+  QuadUV uv;
+  ALLEGRO_VERTEX v[QUAD_VERTICES];
+  meeple_uv(m->color, uv);
+  quad_push(v, x + MP_X[m->pos] * s - ms / 2 - s / 2, y + MP_Y[m->pos] * s - ms / 2 - s / 2, ms, ms, uv, level, tint);
+  al_draw_prim(v, NULL, bitmaps.atlas[level], 0, QUAD_VERTICES, ALLEGRO_PRIM_TRIANGLE_LIST);
+  PROFILE_DRAW(1);
+}
+
+/** Zakres pól planszy [from, to] widocznych na odcinku ekranu [0, size], gdy pole 0 ma środek w `b` */
+static void board_visible(float b, float s, float size, int *from, int *to)
+{
+  *from = ceilf((-s / 2 - b) / s);
+  *to = floorf((size + s / 2 - b) / s);
+  *from = *from < 0 ? 0 : *from;
+  *to = *to > BOARD_SIZE - 1 ? BOARD_SIZE - 1 : *to;
+}
+
+/**
+ * Warstwa planszy: wyłożone płytki i podwładni narysowani raz na osobnej bitmapie, obejmującej prostokąt
+ * z wszystkimi płytkami. Co klatkę rysowana jest tylko ta bitmapa. Warstwa jest rysowana na nowo po zmianie planszy
+ * (`board_version`) albo skali - rozmiar pola na warstwie to najbliższa potęga dwójki nie mniejsza od rozmiaru
+ * pola na ekranie, więc w trakcie animacji przybliżenia warstwa zmienia się co najwyżej raz na krok przybliżenia.
+ */
+#define BOARD_LAYER_MAX 4096
+static _Thread_local struct BoardLayer
+{
+  ALLEGRO_BITMAP *bitmap;
+  unsigned int version;
+  /** Rozmiar pola na warstwie, pierwsze pole i liczba pól */
+  int s, x, y, w, h;
+} layer;
+
+static void board_layer_destroy()
+{
+  if (layer.bitmap)
+    al_destroy_bitmap(layer.bitmap);
+  layer.bitmap = NULL;
+}
+
+static void board_layer_update(float s)
+{
+  int x0 = BOARD_SIZE, y0 = BOARD_SIZE, x1 = 0, y1 = 0;
+  for (int i = 0; i < board.tile_count; i++)
+  {
+    x0 = board.pos[i][0] < x0 ? board.pos[i][0] : x0;
+    y0 = board.pos[i][1] < y0 ? board.pos[i][1] : y0;
+    x1 = board.pos[i][0] > x1 ? board.pos[i][0] : x1;
+    y1 = board.pos[i][1] > y1 ? board.pos[i][1] : y1;
+  }
+  int w = x1 - x0 + 1, h = y1 - y0 + 1;
+
+  int ls = 8;
+  while (ls < 256 && ls < s)
+    ls *= 2;
+  while (ls > 8 && (w > h ? w : h) * ls > BOARD_LAYER_MAX)
+    ls /= 2;
+
+  if (layer.bitmap && layer.version == board_version && layer.s == ls)
+    return;
+
+  if (layer.bitmap && (al_get_bitmap_width(layer.bitmap) != w * ls || al_get_bitmap_height(layer.bitmap) != h * ls))
+    board_layer_destroy();
+  if (!layer.bitmap)
+    layer.bitmap = al_create_bitmap(w * ls, h * ls);
+  MUST_INIT(layer.bitmap, "board layer");
+
+  layer.version = board_version;
+  layer.s = ls;
+  layer.x = x0;
+  layer.y = y0;
+  layer.w = w;
+  layer.h = h;
+
+  ALLEGRO_STATE state;
+  al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+  al_set_target_bitmap(layer.bitmap);
+  al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+
+  // Najpierw wszystkie płytki, potem podwładni - wszystko z jednego poziomu atlasu, jednym wywołaniem
+  static ALLEGRO_VERTEX v[2 * TILE_COUNT * QUAD_VERTICES];
+  ALLEGRO_VERTEX *end = v;
+  ALLEGRO_COLOR white = al_map_rgb_f(1, 1, 1);
+  int level = res_atlas_level(ls);
+  tile_uv_init();
+
+  for (int i = 0; i < board.tile_count; i++)
+  {
+    Tile *t = &board.tiles[i];
+    end = quad_push(end, (board.pos[i][0] - x0) * ls, (board.pos[i][1] - y0) * ls, ls, ls, tile_uv[t->bitmap][t->rot],
+                    level, white);
+  }
 
-  al_draw_tinted_scaled_bitmap(bitmaps.meeple[m->color - 1], tint, 0, 0, BMP_MEEPLE_S, BMP_MEEPLE_S,
-                               x + MP_X[m->pos] * s - ms / 2 - s / 2, y + MP_Y[m->pos] * s - ms / 2 - s / 2, ms, ms, 0);
+  float ms = ls / 3.0;
+  for (int i = 0; i < board.tile_count; i++)
+  {
+    Meeple *m = &board.tiles[i].meeple;
+    if (m->color == MeepleNone)
+      continue;
+
+    QuadUV uv;
+    meeple_uv(m->color, uv);
+    end = quad_push(end, (board.pos[i][0] - x0 + MP_X[m->pos]) * ls - ms / 2,
+                    (board.pos[i][1] - y0 + MP_Y[m->pos]) * ls - ms / 2, ms, ms, uv, level, white);
+  }
+
+  al_draw_prim(v, NULL, bitmaps.atlas[level], 0, end - v, ALLEGRO_PRIM_TRIANGLE_LIST);
+  PROFILE_DRAW(1);
+
+  al_restore_state(&state);
 }
 
-void board_render(float bx, float by, float s)
+void board_render(float bx, float by, float s, float w, float h)
 {
-  al_hold_bitmap_drawing(true);
+  int x0, x1, y0, y1;
+  board_visible(bx, s, w, &x0, &x1);
+  board_visible(by, s, h, &y0, &y1);
+
+  // Tło jest rysowane blokami 8x8 pól, więc zakres zaczyna się od początku bloku
+  static QuadUV BG_UV = {{0, 0}, {512, 0}, {512, 512}, {0, 512}};
+  static ALLEGRO_VERTEX bg[((BOARD_SIZE + 7) / 8) * ((BOARD_SIZE + 7) / 8) * QUAD_VERTICES];
+  ALLEGRO_VERTEX *end = bg;
+
+  for (int ty = y0 & ~7; ty <= y1; ty += 8)
+    for (int tx = x0 & ~7; tx <= x1; tx += 8)
+      end = quad_push(end, bx + tx * s - s / 2, by + ty * s - s / 2, 8 * s, 8 * s, BG_UV, 0, al_map_rgb_f(1, 1, 1));
 
-  for (int ty = 0; ty < BOARD_SIZE; ty += 8)
-    for (int tx = 0; tx < BOARD_SIZE; tx += 8)
-      al_draw_scaled_bitmap(bitmaps.bg, 0, 0, 512, 512, bx + tx * s - s / 2, by + ty * s - s / 2, 8 * s, 8 * s, 0);
+  al_draw_prim(bg, NULL, bitmaps.bg, 0, end - bg, ALLEGRO_PRIM_TRIANGLE_LIST);
+  PROFILE_DRAW(1);
 
-  for (int ty = 0; ty < BOARD_SIZE; ty++)
-    for (int tx = 0; tx < BOARD_SIZE; tx++)
-      if (board.grid[ty][tx])
-        tile_render(board.grid[ty][tx], bx + tx * s, by + ty * s, s, 0);
+  if (board.tile_count)
+  {
+    board_layer_update(s);
+    al_draw_scaled_bitmap(layer.bitmap, 0, 0, layer.w * layer.s, layer.h * layer.s, bx + (layer.x - 0.5) * s,
+                          by + (layer.y - 0.5) * s, layer.w * s, layer.h * s, 0);
+    PROFILE_DRAW(1);
+  }
 
-  al_hold_bitmap_drawing(false);
+  // Płytka tymczasowa (np. płytka gracza w trakcie wyboru podwładnego) nie należy do warstwy
+  if (tile_tmp && board.grid[tile_tmp_y][tile_tmp_x] == BOARD_TILE_TMP)
+    tile_render(tile_tmp, bx + tile_tmp_x * s, by + tile_tmp_y * s, s, 0);
 }
@@ -134,10 +134,32 @@ typedef bool MeepleValidPos[13];
  */
 typedef int CollectMeeplePos[MEEPLE_COLOR_COUNT + 1][2];
 
+/**
+ * Plansza
+ * Ponieważ na planszy można ułożyć 72 płytki, a potencjalnie mogą one być ułożone w jednym rzędzie,
+ * musi ona zmieścić 72 płytki w każdą stronę od środka.
+ * Płytki są trzymane w tablicy w kolejności wyłożenia, a plansza przechowuje jedynie ich numery (powiększone o 1,
+ * 0 - puste pole). Struktura nie zawiera wskaźników, więc można ją kopiować jak zwykłą wartość.
+ */
+#define BOARD_TILE_TMP 0xff
+typedef struct Board
+{
+  uint8_t grid[BOARD_SIZE + 1][BOARD_SIZE + 1];
+  Tile tiles[TILE_COUNT];
+  /** Współrzędne wyłożonych płytek */
+  uint8_t pos[TILE_COUNT][2];
+  uint8_t tile_count;
+} Board;
+
 // Board methods
 void board_init();
 void board_deinit();
 
+/** Ustawia planszę, na której działają funkcje modułu w obecnym wątku. NULL - własna plansza wątku */
+void board_use(Board *b);
+void board_save(Board *b);
+void board_load(const Board *b);
+
 /**
  * Algorytm BFS chodzący po danym, jednym obiekcie.
  * x, y, pos - wpółrzędne płytki i pozycja, z której algorytm powinien zacząć działanie
@@ -149,6 +171,16 @@ void board_deinit();
 typedef void (*board_bfs_cb)(int x, int y, TilePos pos, bool revisit, void *data);
 bool board_bfs(int x, int y, TilePos pos, board_bfs_cb cb, void *data);
 
+#ifdef BOT_STATS
+/** Liczba wywołań BFS i odwiedzonych fragmentów płytek od początku działania wątku */
+typedef struct BfsStats
+{
+  uint64_t calls, cells;
+} BfsStats;
+
+extern _Thread_local BfsStats bfs_stats;
+#endif
+
 /** Zwraca wskaźnik do płytki na danych współrzędnych */
 Tile *board_tile_get(int x, int y);
 /** Sprawdza, czy płytkę można postawić na danych współrzędnych */
@@ -159,7 +191,8 @@ bool board_tile_valid(Tile *tile);
 void board_tile_place(Tile *tile, int x, int y);
 /** Stawia płytkę, ale bez kopiowania jej na wewnętrzny stos. Wykorzystywana przez
  * bota w celu sprawdzenia opłacalności ruchu. W przeciwieństwie do wcześniejszej
- * funkcji, wykonanie tej można cofnąć podając za argument NULL*/
+ * funkcji, wykonanie tej można cofnąć podając za argument NULL. Naraz może być położona tylko jedna
+ * taka płytka, a wskaźnik do niej nie jest częścią stanu planszy */
 void board_tile_tmp(Tile *tile, int x, int y);
 
 /** Sprawdza, czy podwładnego można postawić na danej płytce */
@@ -171,7 +204,8 @@ void board_meeple_place(Meeple *meeple, int x, int y);
 /** Liczy/zbiera podwładnych z danego obiektu */
 void board_collect_meeple(int x, int y, TilePos pos, bool remove, MeepleCounts meeple, CollectMeeplePos meeple_pos);
 
-void board_render(float x, float y, float s);
+/** Rysuje widoczną część planszy. x, y - środek pola (0, 0), s - rozmiar pola, w, h - rozmiar ekranu */
+void board_render(float x, float y, float s, float w, float h);
 
 // Tile methods
 void tile_rotate(Tile *tile);
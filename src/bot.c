@@ -1,11 +1,11 @@
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "./board.h"
 #include "./bot.h"
-
-#define RANDOMIZE(X) (X + (1.0 * rand() / RAND_MAX) - 0.5)
+#include "./utils.h"
 
 typedef struct FeatureIds
 {
@@ -14,25 +14,120 @@ typedef struct FeatureIds
 
 static int TILE_IDX[5][3] = {{0, -1, 1}, {1, 0, 4}, {0, 1, 7}, {-1, 0, 10}, {0, 0, 12}};
 
+/**
+ * Puste pola sąsiadujące z obiektem, pogrupowane według liczby płytek, które mogą na nich pasować.
+ * W przeciwieństwie do samego prawdopodobieństwa nie zależy od liczby pozostałych tur, dzięki czemu
+ * ocena ruchu może być przechowywana między turami. Jeżeli różnych wartości jest zbyt wiele, ustawiana jest
+ * flaga `overflow`, a prawdopodobieństwo jest liczone tylko na bieżąco (w polu `c_prob` obiektu).
+ */
+#define FEATURE_OPEN_MAX 8
+typedef struct FeatureOpen
+{
+  uint8_t count;
+  bool overflow;
+  uint8_t tiles[FEATURE_OPEN_MAX];
+  uint8_t cells[FEATURE_OPEN_MAX];
+} FeatureOpen;
+
 typedef struct Feature
 {
   TileType type;
-  int id;
-  int points;
+  uint8_t meeple[MEEPLE_COLOR_COUNT + 1];
+  uint16_t points;
   float c_prob;
-  MeepleCounts meeple;
+  FeatureOpen open;
 } Feature;
 
-static Feature features[BOARD_SIZE * 4];
-static FeatureIds feature_ids;
-static int last_feature_id;
+static _Thread_local Feature features[BOARD_SIZE * 4];
+static _Thread_local uint64_t feature_hashes[BOARD_SIZE * 4];
+static _Thread_local FeatureIds feature_ids;
+static _Thread_local int last_feature_id;
+
+// Hashing
+
+static uint64_t hash_mix(uint64_t h)
+{
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+#define HASH_CELL(X, Y, V) hash_mix(((uint64_t)(X) << 40) | ((uint64_t)(Y) << 24) | (uint64_t)(V))
+
+// Noise
+
+/**
+ * Do ocen ruchów dodawana jest mała, losowa liczba z przedziału [-0.5, 0.5). Zależy ona tylko od liczby pobranej
+ * z generatora gry na początku tury, ruchu i obiektu, a nie od kolejności oceniania ruchów, więc odrzucanie ruchów
+ * nie zmienia wyboru bota.
+ */
+#define RANDOMIZE(X, K) ((X) + bot_noise(K))
+#define NOISE_MAX 0.5
+
+static _Thread_local uint64_t noise_turn;
+
+static float bot_noise(uint64_t key)
+{
+  return (hash_mix(key) >> 40) * (1.0 / (1 << 24)) - NOISE_MAX;
+}
+
+// Statistics
+
+#ifdef BOT_STATS
+#include <time.h>
+
+static _Thread_local BotStats stats;
+static FILE *stats_file;
+
+static double stats_time_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+BotStats bot_stats()
+{
+  return stats;
+}
+
+void bot_stats_log(FILE *f)
+{
+  stats_file = f;
+}
+
+static void stats_write(Player *player, int remaining)
+{
+  if (!stats_file)
+    return;
+
+  fprintf(stats_file,
+          "{\"color\":%d,\"remaining\":%d,\"candidates\":%d,\"evaluated\":%d,\"cache_hits\":%d,"
+          "\"bfs_calls\":%llu,\"bfs_cells\":%llu,\"prob_calls\":%llu,\"features_ms\":%.3f,\"search_ms\":%.3f}\n",
+          player->color, remaining, stats.candidates, stats.evaluated, stats.cache_hits,
+          (unsigned long long)stats.bfs_calls, (unsigned long long)stats.bfs_cells,
+          (unsigned long long)stats.prob_calls, stats.features_ms, stats.search_ms);
+}
+#endif
+
+// Probability
+
+/** Prawdopodobieństwo wylosowania do końca gry płytki spośród `tiles` pasujących, wyliczane raz na turę */
+static _Thread_local float tile_probabilities[TILE_COUNT + 1];
+
+static void tile_probability_update(int remaining)
+{
+  for (int tiles = 0; tiles <= TILE_COUNT; tiles++)
+    tile_probabilities[tiles] = 1 - pow(1 - 1.0 * tiles / TILE_COUNT, remaining);
+}
 
 /**
- * Funkcja licząca przybliżone prawdopodobieństwo tego, że do końca gry uda się wylosować
- * Płytkę, która będzie pasować na danym polu. Funkcja ta bierze pod uwagę jedynie liczbę dróg i miast
- * Sąsiadujących z danym polem.
+ * Funkcja licząca przybliżoną liczbę płytek, które mogą pasować na danym polu. Funkcja ta bierze pod
+ * uwagę jedynie liczbę dróg i miast sąsiadujących z danym polem.
  */
-static float tile_probability(int x, int y, int remaining)
+static int tile_fit_count(int x, int y)
 {
   static int TILE_COUNTS[5][5] = {
       {4, 2, 17, 4, 1}, {5, 0, 10, 3, 0}, {13, 0, 5, 0, 0}, {4, 3, 0, 0, 0}, {1, 0, 0, 0, 0},
@@ -63,31 +158,124 @@ static float tile_probability(int x, int y, int remaining)
     for (int j = 0; j <= unknown; j++)
       tiles += TILE_COUNTS[cities + i][roads + j];
 
-  return 1 - pow(1 - 1.0 * tiles / 72, remaining);
+  return tiles;
 }
 
-bool C_PROB[BOARD_SIZE][BOARD_SIZE];
+/**
+ * Przybliżone prawdopodobieństwo tego, że do końca gry uda się wylosować płytkę, która będzie pasować
+ * na polu, na które pasuje `tiles` płytek.
+ */
+static float tile_probability(int tiles)
+{
+  STATS(stats.prob_calls++);
+  return tile_probabilities[tiles];
+}
+
+// Features
+
+/**
+ * Otoczenie (5x5) ocenianego ruchu. Zaznaczane są w nim obiekty, które zostały już uwzględnione w ocenie,
+ * dzięki czemu ten sam obiekt nie zostanie policzony dwukrotnie. Obiekty spoza otoczenia nigdy nie są sprawdzane.
+ */
+#define TURN_R 2
+typedef struct TurnWindow
+{
+  int x, y;
+  bool t[2 * TURN_R + 1][2 * TURN_R + 1][8];
+} TurnWindow;
+
+#define TURN_WINDOW_IN(W, X, Y)                                                                                        \
+  ((X) - (W)->x >= -TURN_R && (X) - (W)->x <= TURN_R && (Y) - (W)->y >= -TURN_R && (Y) - (W)->y <= TURN_R)
+#define TURN_WINDOW_AT(W, X, Y, ID) (W)->t[(Y) - (W)->y + TURN_R][(X) - (W)->x + TURN_R][ID]
+
 typedef struct FeatureData
 {
   Feature *feature;
+  uint64_t hash;
+  /** Identyfikator obiektu i tablica, w której jest zapisywany (ocena obiektów na początku tury) */
   FeatureIds *ids;
-  int remaining;
+  int id;
+  /** Otoczenie ocenianego ruchu (ocena ruchu) */
+  TurnWindow *window;
 } FeatureData;
 
+/**
+ * Pola sąsiadujące z obecnie ocenianym obiektem, które zostały już uwzględnione w prawdopodobieństwie jego
+ * ukończenia. Czyszczone po ocenie każdego obiektu.
+ */
+static _Thread_local bool open_marked[BOARD_SIZE][BOARD_SIZE];
+static _Thread_local int open_cells[(TILE_COUNT + 1) * 4][2];
+static _Thread_local int open_count;
+
+static void feature_mark(FeatureData *data, int x, int y, TileId id)
+{
+  if (data->ids)
+    data->ids->t[y][x][id] = data->id;
+  if (data->window && TURN_WINDOW_IN(data->window, x, y))
+    TURN_WINDOW_AT(data->window, x, y, id) = true;
+
+  data->hash += HASH_CELL(x, y, id);
+}
+
+static void feature_open_add(FeatureData *data, int x, int y)
+{
+  Feature *feat = data->feature;
+  FeatureOpen *open = &feat->open;
+  int tiles = tile_fit_count(x, y);
+
+  open_marked[y][x] = true;
+  open_cells[open_count][0] = x;
+  open_cells[open_count][1] = y;
+  open_count++;
+
+  feat->c_prob *= tile_probability(tiles);
+  data->hash += HASH_CELL(x, y, 0x100 | tiles);
+
+  for (int i = 0; i < open->count; i++)
+    if (open->tiles[i] == tiles)
+    {
+      open->cells[i]++;
+      return;
+    }
+
+  if (open->count == FEATURE_OPEN_MAX)
+  {
+    open->overflow = true;
+    return;
+  }
+
+  open->tiles[open->count] = tiles;
+  open->cells[open->count] = 1;
+  open->count++;
+}
+
+/** Prawdopodobieństwo ukończenia obiektu przy obecnej liczbie pozostałych tur */
+static float feature_c_prob(Feature *feat)
+{
+  if (feat->open.overflow)
+    return feat->c_prob;
+
+  float c_prob = 1.0;
+  for (int i = 0; i < feat->open.count; i++)
+    for (int j = 0; j < feat->open.cells[i]; j++)
+      c_prob *= tile_probability(feat->open.tiles[i]);
+
+  return c_prob;
+}
+
 /** Wylicza bezwzględną oczekiwaną wartość danego obiektu */
 static float feature_value(Feature *feat)
 {
   int a = feat->points;
   int b = feat->type == TileTypeCity ? a / 2 : a;
-  return feat->c_prob * a + (1 - feat->c_prob) * b;
+  float c_prob = feature_c_prob(feat);
+  return c_prob * a + (1 - c_prob) * b;
 }
 
 /** Wylicza oczekiwaną wartość dla danego gracza. Wartość ta jest dodatnia, ujemna albo zerowa
  * w zależności od liczby podwładnych własnych i przeciwnika. */
 static float feature_relative_value(Feature *feat, MeepleColor player)
 {
-  float value = feature_value(feat);
-
   int own = 0, opponent = 0;
   for (int i = 0; i <= MEEPLE_COLOR_COUNT; i++)
     if (i == player)
@@ -95,26 +283,30 @@ static float feature_relative_value(Feature *feat, MeepleColor player)
     else
       opponent = feat->meeple[i] > opponent ? feat->meeple[i] : opponent;
 
-  return own == 0 && opponent == 0 ? 0 : own >= opponent ? value : -value;
+  if (own == 0 && opponent == 0)
+    return 0;
+
+  float value = feature_value(feat);
+  return own >= opponent ? value : -value;
 }
 
 static void evaluate_feature_cb(int x, int y, TilePos pos, bool revisit, FeatureData *data)
 {
   Tile *tile = board_tile_get(x, y);
   Feature *feat = data->feature;
-  data->ids->t[y][x][tile->ids[pos]] = feat->id;
+  TileId id = tile->ids[pos];
+
+  feature_mark(data, x, y, id);
 
   if (!revisit)
     feat->points += feat->type == TileTypeCity ? tile->flags & TileFlagPennant ? 4 : 2 : 1;
 
-  TileId id = tile->ids[pos];
   for (int i = 0; i < 4; i++)
   {
     int dx = TILE_IDX[i][0], dy = TILE_IDX[i][1], pos = TILE_IDX[i][2];
-    if (tile->ids[pos] != id || C_PROB[y + dy][x + dx] || board_tile_get(x + dx, y + dy))
+    if (tile->ids[pos] != id || open_marked[y + dy][x + dx] || board_tile_get(x + dx, y + dy))
       continue;
-    C_PROB[y + dy][x + dx] = true;
-    feat->c_prob *= tile_probability(x + dx, y + dy, data->remaining);
+    feature_open_add(data, x + dx, y + dy);
   }
 
   if (tile->meeple.color != MeepleNone && tile->ids[tile->meeple.pos] == id)
@@ -122,35 +314,44 @@ static void evaluate_feature_cb(int x, int y, TilePos pos, bool revisit, Feature
 }
 
 /** Wylicza wartość obiektu na danym polu */
-static void evaluate_feature(int x, int y, TilePos pos, int remaining, FeatureIds *ids, int id)
+static void evaluate_feature(int x, int y, TilePos pos, FeatureData *data)
 {
   Tile *t = board_tile_get(x, y);
-  int tid = t->ids[pos];
-  ids->t[y][x][tid] = id;
-  features[id] = (Feature){.type = t->types[pos], .id = id, .points = 0, .c_prob = 1.0};
+  Feature *feat = data->feature;
+  TileId tid = t->ids[pos];
 
-  if (features[id].type == TileTypeMonastery)
+  *feat = (Feature){.type = t->types[pos], .points = 0, .c_prob = 1.0};
+  data->hash = 0;
+  feature_mark(data, x, y, tid);
+
+  if (feat->type == TileTypeMonastery)
   {
     for (int dy = -1; dy <= 1; dy++)
       for (int dx = -1; dx <= 1; dx++)
       {
-        Tile *t = board_tile_get(x + dx, y + dy);
-        if (t)
-          features[id].points++;
+        if (board_tile_get(x + dx, y + dy))
+          feat->points++;
         else
-          features[id].c_prob *= tile_probability(x + dx, y + dy, remaining);
+          feature_open_add(data, x + dx, y + dy);
       }
   }
   else
-  {
-    FeatureData data = {.remaining = remaining, .feature = &features[id], .ids = ids};
-    board_bfs(x, y, pos, (board_bfs_cb)evaluate_feature_cb, &data);
-  }
+    board_bfs(x, y, pos, (board_bfs_cb)evaluate_feature_cb, data);
+
+  for (; open_count > 0; open_count--)
+    open_marked[open_cells[open_count - 1][1]][open_cells[open_count - 1][0]] = false;
+
+  uint64_t summary = feat->type | feat->points << 8;
+  for (int i = 0; i <= MEEPLE_COLOR_COUNT; i++)
+    summary = summary << 4 ^ feat->meeple[i];
+  data->hash = hash_mix(data->hash ^ hash_mix(summary));
 }
 
 /* Wylicza wartości wszystkich obiektów w grze */
 static void evaluate_all_features(int remaining)
 {
+  tile_probability_update(remaining);
+
   last_feature_id = 0;
   memset(&feature_ids, 0, sizeof(feature_ids));
   for (int y = 1; y < BOARD_SIZE; y++)
@@ -165,130 +366,426 @@ static void evaluate_all_features(int remaining)
           int id = tile->ids[pos];
           if (feature_ids.t[y][x][id])
             continue;
-          evaluate_feature(x, y, pos, remaining, &feature_ids, ++last_feature_id);
+
+          FeatureData data = {.feature = &features[++last_feature_id], .ids = &feature_ids, .id = last_feature_id};
+          evaluate_feature(x, y, pos, &data);
+          feature_hashes[last_feature_id] = data.hash;
         }
     }
 }
 
-typedef struct TurnEvaluationState
+// Turn evaluation
+
+/**
+ * Miejsca, w których ruch może zmienić wartość obiektów: współrzędne względem stawianej płytki i pozycja na płytce.
+ * Pierwsze `TURN_MEEPLE_COUNT` leży na stawianej płytce, więc może na nich stanąć podwładny.
+ */
+#define TURN_HELPER_COUNT 29
+#define TURN_MEEPLE_COUNT 5
+// clang-format off
+static int TURN_HELPERS[TURN_HELPER_COUNT][3] = {
+    {0, 0, 1}, {0, 0, 4}, {0, 0, 7}, {0, 0, 10}, {0, 0, 12},
+    {0, -1, 7}, {1, 0, 10}, {0, 1, 1}, {-1, 0, 4},
+    {0, -2, 7}, {2, 0, 10}, {0, 2, 1}, {-2, 0, 4},
+    {-1, -1, 4}, {-1, -1, 7}, {1, -1, 7}, {1, -1, 10}, {1, 1, 10}, {1, 1, 1}, {-1, 1, 1}, {-1, 1, 4},
+    {-1, -1, 12}, {0, -1, 12}, {1, -1, 12}, {1, 0, 12}, {1, 1, 12}, {0, 1, 12}, {-1, 1, 12}, {-1, 0, 12},
+};
+// clang-format on
+
+/** Obiekt powstały (albo zmieniony) po postawieniu płytki, razem z miejscem, w którym został znaleziony */
+typedef struct TurnFeature
 {
-  FeatureIds included_ids;
-  long long int excluded_ids[BOARD_SIZE / 16];
-  float ans;
-  Meeple best_meeple;
-  float best_meeple_value;
-  int remaining;
-  Player *player;
-} TurnEvaluationState;
+  Feature feature;
+  uint8_t helper;
+} TurnFeature;
 
-/** Aktualizuje całkowitą wartość ruchu, poprawiając wartość obiektu znajdującego się w danym miejscu */
-void evaluate_turn_helper(int x, int y, TilePos pos, bool meeple, TurnEvaluationState *state)
+typedef struct TurnEval
 {
-  Tile *tile = board_tile_get(x, y);
-  if (!tile || tile->types[pos] == TileTypeField)
-    return;
+  int count;
+  bool cacheable;
+  TurnFeature features[TURN_HELPER_COUNT];
+} TurnEval;
 
-  TileId tid = tile->ids[pos];
-  if (!tid)
-    return;
+/**
+ * Pamięć podręczna ocen ruchów. Ocena ruchu zależy tylko od stawianej płytki, otoczenia 5x5 i obiektów, które
+ * przez to otoczenie przechodzą, więc kluczem jest skrót tych danych. Przechowywane są obiekty, a nie gotowe
+ * wartości, ponieważ te zależą od liczby pozostałych tur i koloru gracza. Ruchy, których otoczenie nie zmieniło
+ * się od poprzedniej tury, nie wymagają ponownego chodzenia po planszy.
+ */
+#define EVAL_CACHE_SIZE 4096
+#define EVAL_CACHE_FEATURES 16
+typedef struct CachedTurn
+{
+  uint64_t key;
+  int count;
+  TurnFeature features[EVAL_CACHE_FEATURES];
+} CachedTurn;
+
+static _Thread_local CachedTurn eval_cache[EVAL_CACHE_SIZE];
+
+static uint64_t tile_hash(Tile *t)
+{
+  uint64_t h = t->flags;
+  for (int i = 0; i < 13; i++)
+    h = hash_mix(h ^ t->types[i] << 8 ^ t->ids[i]);
+  return h;
+}
+
+/** Skrót wszystkiego, od czego zależy ocena ruchu (poza liczbą pozostałych tur i graczem) */
+static uint64_t turn_key(Turn *turn)
+{
+  uint64_t key = hash_mix(HASH_CELL(turn->x, turn->y, 0) ^ tile_hash(&turn->tile));
+
+  for (int dy = -TURN_R; dy <= TURN_R; dy++)
+    for (int dx = -TURN_R; dx <= TURN_R; dx++)
+    {
+      Tile *t = board_tile_get(turn->x + dx, turn->y + dy);
+      uint64_t cell = t ? 1 | t->bitmap << 1 | t->rot << 6 | t->meeple.color << 8 | t->meeple.pos << 12 : 0;
+      key = hash_mix(key ^ cell);
+    }
+
+  for (int i = TURN_MEEPLE_COUNT; i < TURN_HELPER_COUNT; i++)
+  {
+    int x = turn->x + TURN_HELPERS[i][0], y = turn->y + TURN_HELPERS[i][1], pos = TURN_HELPERS[i][2];
+    Tile *t = board_tile_get(x, y);
+    if (!t || t->types[pos] == TileTypeField || !t->ids[pos])
+      continue;
+    int fid = feature_ids.t[y][x][t->ids[pos]];
+    key = hash_mix(key ^ feature_hashes[fid] ^ i);
+  }
+
+  return key | 1;
+}
+
+/** Wylicza obiekty, których wartość zmieni się po wykonaniu ruchu */
+static void evaluate_turn_features(Turn *turn, TurnEval *eval)
+{
+  board_tile_tmp(&turn->tile, turn->x, turn->y);
+
+  static _Thread_local TurnWindow window;
+  memset(&window, 0, sizeof(window));
+  window.x = turn->x;
+  window.y = turn->y;
+
+  eval->count = 0;
+  eval->cacheable = true;
+
+  for (int i = 0; i < TURN_HELPER_COUNT; i++)
+  {
+    int x = turn->x + TURN_HELPERS[i][0], y = turn->y + TURN_HELPERS[i][1], pos = TURN_HELPERS[i][2];
+
+    Tile *tile = board_tile_get(x, y);
+    if (!tile || tile->types[pos] == TileTypeField)
+      continue;
+
+    TileId tid = tile->ids[pos];
+    if (!tid || TURN_WINDOW_AT(&window, x, y, tid))
+      continue;
+
+    TurnFeature *tf = &eval->features[eval->count++];
+    tf->helper = i;
+
+    FeatureData data = {.feature = &tf->feature, .window = &window};
+    evaluate_feature(x, y, pos, &data);
+
+    if (tf->feature.open.overflow)
+      eval->cacheable = false;
+  }
+
+  board_tile_tmp(NULL, turn->x, turn->y);
+}
+
+/** Suma wartości obiektów sprzed ruchu, których wartość może się zmienić po jego wykonaniu */
+static float turn_old_value(Player *player, Turn *turn)
+{
+  float ans = 0;
+
+  int excluded[TURN_HELPER_COUNT], excluded_count = 0;
+  for (int i = TURN_MEEPLE_COUNT; i < TURN_HELPER_COUNT; i++)
+  {
+    int x = turn->x + TURN_HELPERS[i][0], y = turn->y + TURN_HELPERS[i][1], pos = TURN_HELPERS[i][2];
+    Tile *t = board_tile_get(x, y);
+    if (!t || t->types[pos] == TileTypeField || !t->ids[pos])
+      continue;
+
+    int fid = feature_ids.t[y][x][t->ids[pos]], j = 0;
+    while (j < excluded_count && excluded[j] != fid)
+      j++;
+    if (!fid || j < excluded_count)
+      continue;
 
-  if (!state->included_ids.t[y][x][tid])
+    excluded[excluded_count++] = fid;
+    ans += feature_relative_value(&features[fid], player->color);
+  }
+
+  return ans;
+}
+
+/** Oblicza oczekiwany przyrost punktów dla danego ruchu na podstawie zmienionych obiektów */
+static float turn_value(TurnFeature *feats, int count, Player *player, Turn *turn, uint64_t key)
+{
+  float ans = 0;
+  Meeple best_meeple = {.color = MeepleNone};
+  float best_meeple_value = 0;
+
+  for (int i = 0; i < count; i++)
   {
-    evaluate_feature(x, y, pos, state->remaining, &state->included_ids, ++last_feature_id);
-    float value = feature_relative_value(&features[last_feature_id], state->player->color);
-    state->ans += RANDOMIZE(value);
-    if (!value && meeple && state->player->meeple > 0)
+    Feature *feat = &feats[i].feature;
+    float value = feature_relative_value(feat, player->color);
+    ans += RANDOMIZE(value, key + 2 * i);
+
+    if (!value && feats[i].helper < TURN_MEEPLE_COUNT && player->meeple > 0)
     {
-      value = RANDOMIZE(feature_value(&features[last_feature_id]));
-      if (value > state->best_meeple_value)
+      value = RANDOMIZE(feature_value(feat), key + 2 * i + 1);
+      if (value > best_meeple_value)
       {
-        state->best_meeple.color = state->player->color;
-        state->best_meeple.pos = pos;
-        state->best_meeple_value = value;
+        best_meeple.color = player->color;
+        best_meeple.pos = TURN_HELPERS[feats[i].helper][2];
+        best_meeple_value = value;
       }
     }
   }
 
-  int fid = feature_ids.t[y][x][tid];
-  if (fid && !(state->excluded_ids[fid / 64] & (1 << (fid % 64))))
+  turn->meeple = best_meeple;
+  return ans - turn_old_value(player, turn) + best_meeple_value;
+}
+
+/**
+ * Szybkie górne ograniczenie oceny ruchu, liczone bez chodzenia po planszy. Obiekt zawierający stawianą płytkę
+ * ma co najwyżej tyle punktów, co sąsiadujące z nią obiekty razem z płytką, a wartość obiektu nie przekracza
+ * liczby jego punktów. Obiekty, z którymi płytka się nie łączy, zachowują punkty i podwładnych, więc zmienia się
+ * tylko prawdopodobieństwo ich ukończenia. Wartość obiektów sprzed ruchu jest znana dokładnie.
+ */
+static float turn_bound(Player *player, Turn *turn)
+{
+  int merged[TURN_HELPER_COUNT], merged_count = 0;
+  float bound = 0, meeple_bound = 0;
+  int terms = 0;
+
+  Tile *tile = &turn->tile;
+  for (int i = 0; i < TURN_MEEPLE_COUNT; i++)
   {
-    float value = feature_relative_value(&features[fid], state->player->color);
-    state->ans -= value;
-    state->excluded_ids[fid / 64] |= 1 << (fid % 64);
+    TilePos pos = TURN_HELPERS[i][2];
+    TileId tid = tile->ids[pos];
+    if (tile->types[pos] == TileTypeField || !tid)
+      continue;
+
+    bool seen = false;
+    for (int j = 0; j < i; j++)
+      seen |= tile->ids[TURN_HELPERS[j][2]] == tid;
+    if (seen)
+      continue;
+
+    int points = 0;
+    bool meeple = false;
+    if (tile->types[pos] == TileTypeMonastery)
+    {
+      for (int dy = -1; dy <= 1; dy++)
+        for (int dx = -1; dx <= 1; dx++)
+          points += dx == 0 && dy == 0 ? 1 : board_tile_get(turn->x + dx, turn->y + dy) != NULL;
+    }
+    else
+    {
+      points = tile->types[pos] == TileTypeCity ? tile->flags & TileFlagPennant ? 4 : 2 : 1;
+
+      // Obiekty na sąsiednich płytkach, z którymi łączy się dany obiekt
+      for (int e = 0; e < 4; e++)
+      {
+        int x = turn->x + TURN_HELPERS[e + 5][0], y = turn->y + TURN_HELPERS[e + 5][1];
+        Tile *t = board_tile_get(x, y);
+        if (!t || tile->ids[TURN_HELPERS[e][2]] != tid)
+          continue;
+
+        int fid = feature_ids.t[y][x][t->ids[TURN_HELPERS[e + 5][2]]];
+        points += features[fid].points;
+        for (int c = 1; c <= MEEPLE_COLOR_COUNT; c++)
+          meeple |= features[fid].meeple[c] > 0;
+        merged[merged_count++] = fid;
+      }
+    }
+
+    terms++;
+    if (meeple)
+      bound += points;
+    else if (points + NOISE_MAX > meeple_bound)
+      meeple_bound = points + NOISE_MAX;
   }
+
+  int visited[TURN_HELPER_COUNT], visited_count = 0;
+  for (int i = TURN_MEEPLE_COUNT; i < TURN_HELPER_COUNT; i++)
+  {
+    int x = turn->x + TURN_HELPERS[i][0], y = turn->y + TURN_HELPERS[i][1], pos = TURN_HELPERS[i][2];
+    Tile *t = board_tile_get(x, y);
+    if (!t || t->types[pos] == TileTypeField || !t->ids[pos])
+      continue;
+
+    int fid = feature_ids.t[y][x][t->ids[pos]], j = 0, k = 0;
+    while (j < merged_count && merged[j] != fid)
+      j++;
+    while (k < visited_count && visited[k] != fid)
+      k++;
+    if (!fid || j < merged_count || k < visited_count)
+      continue;
+
+    visited[visited_count++] = fid;
+    terms++;
+
+    Feature *feat = &features[fid];
+    float value = feature_relative_value(feat, player->color);
+    if (value > 0)
+      bound += feat->points;
+    else if (value < 0)
+      bound -= feat->type == TileTypeCity ? feat->points / 2 : feat->points;
+  }
+
+  if (player->meeple == 0)
+    meeple_bound = 0;
+
+  return bound + terms * NOISE_MAX + meeple_bound - turn_old_value(player, turn) + 1e-2;
 }
 
-/** Oblicza oczekiwany przyrost punktów dla danego ruchu */
-static float evaluate_turn(Player *player, Turn *turn, int remaining)
+/** Oblicza oczekiwany przyrost punktów dla danego ruchu, korzystając z wcześniejszych ocen, jeżeli to możliwe */
+static float evaluate_turn(Player *player, Turn *turn)
 {
-  board_tile_tmp(&turn->tile, turn->x, turn->y);
+  uint64_t noise_key = hash_mix(noise_turn ^ HASH_CELL(turn->x, turn->y, turn->tile.rot));
+  uint64_t key = turn_key(turn);
+  CachedTurn *cached = &eval_cache[key % EVAL_CACHE_SIZE];
 
-  static TurnEvaluationState state;
-  memset(&state, 0, sizeof(state));
-  state.remaining = remaining;
-  state.player = player;
-
-  int last_feature_id_save = last_feature_id;
-
-  evaluate_turn_helper(turn->x, turn->y, 1, true, &state);
-  evaluate_turn_helper(turn->x, turn->y, 4, true, &state);
-  evaluate_turn_helper(turn->x, turn->y, 7, true, &state);
-  evaluate_turn_helper(turn->x, turn->y, 10, true, &state);
-  evaluate_turn_helper(turn->x, turn->y, 12, true, &state);
-
-  evaluate_turn_helper(turn->x, turn->y - 1, 7, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y, 10, false, &state);
-  evaluate_turn_helper(turn->x, turn->y + 1, 1, false, &state);
-  evaluate_turn_helper(turn->x - 1, turn->y, 4, false, &state);
-
-  evaluate_turn_helper(turn->x, turn->y - 2, 7, false, &state);
-  evaluate_turn_helper(turn->x + 2, turn->y, 10, false, &state);
-  evaluate_turn_helper(turn->x, turn->y + 2, 1, false, &state);
-  evaluate_turn_helper(turn->x - 2, turn->y, 4, false, &state);
-
-  evaluate_turn_helper(turn->x - 1, turn->y - 1, 4, false, &state);
-  evaluate_turn_helper(turn->x - 1, turn->y - 1, 7, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y - 1, 7, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y - 1, 10, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y + 1, 10, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y + 1, 1, false, &state);
-  evaluate_turn_helper(turn->x - 1, turn->y + 1, 1, false, &state);
-  evaluate_turn_helper(turn->x - 1, turn->y + 1, 4, false, &state);
-
-  evaluate_turn_helper(turn->x - 1, turn->y - 1, 12, false, &state);
-  evaluate_turn_helper(turn->x, turn->y - 1, 12, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y - 1, 12, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y, 12, false, &state);
-  evaluate_turn_helper(turn->x + 1, turn->y + 1, 12, false, &state);
-  evaluate_turn_helper(turn->x, turn->y + 1, 12, false, &state);
-  evaluate_turn_helper(turn->x - 1, turn->y + 1, 12, false, &state);
-  evaluate_turn_helper(turn->x - 1, turn->y, 12, false, &state);
+  if (cached->key == key)
+  {
+    STATS(stats.cache_hits++);
+    return turn_value(cached->features, cached->count, player, turn, noise_key);
+  }
 
-  board_tile_tmp(NULL, turn->x, turn->y);
-  last_feature_id = last_feature_id_save;
-  turn->meeple = state.best_meeple;
+  static _Thread_local TurnEval eval;
+  evaluate_turn_features(turn, &eval);
 
-  return state.ans + state.best_meeple_value;
+  if (eval.cacheable && eval.count <= EVAL_CACHE_FEATURES)
+  {
+    cached->key = key;
+    cached->count = eval.count;
+    memcpy(cached->features, eval.features, eval.count * sizeof(TurnFeature));
+  }
+
+  return turn_value(eval.features, eval.count, player, turn, noise_key);
 }
 
-/** Znajduje najbardziej optymalny ruch */
-void bot_turn(Player *player, Turn *turn, int remaining)
+// Search
+
+/** Możliwy ruch razem z górnym ograniczeniem jego oceny i numerem w kolejności przeglądania planszy */
+typedef struct Candidate
 {
-  Turn t = *turn;
-  float best_value = -1e3;
+  Turn turn;
+  float bound;
+  int idx;
+} Candidate;
+
+static _Thread_local Candidate candidates[(TILE_COUNT + 1) * 16];
+
+static int _cmp_candidates(const Candidate *a, const Candidate *b)
+{
+  if (a->bound != b->bound)
+    return a->bound < b->bound ? 1 : -1;
+  return a->idx - b->idx;
+}
+
+/**
+ * Znajduje najbardziej optymalny ruch. Ruchy są oceniane w kolejności malejących ograniczeń, a ocenianie kończy
+ * się, gdy ograniczenie nie pozwala już na poprawienie najlepszej oceny. Przy równych ocenach wygrywa ruch
+ * wcześniejszy w kolejności przeglądania planszy, więc wybór jest taki sam jak przy ocenie wszystkich ruchów.
+ */
+void bot_turn(Player *player, Turn *turn, int remaining, Rng *rng)
+{
+  noise_turn = rng_next(rng);
+
+#ifdef BOT_STATS
+  memset(&stats, 0, sizeof(stats));
+  BfsStats bfs_start = bfs_stats;
+  double time_start = stats_time_ms();
+#endif
 
   evaluate_all_features(remaining);
 
+  STATS(double time_features = stats_time_ms());
+
+  Turn t = *turn;
+  int count = 0;
   for (int r = 0; r < 4; r++, tile_rotate(&t.tile))
     for (t.y = 1; t.y < BOARD_SIZE; t.y++)
       for (t.x = 1; t.x < BOARD_SIZE; t.x++)
         if (board_tile_matches(&t.tile, t.x, t.y))
         {
-          float value = evaluate_turn(player, &t, remaining);
-          if (value > best_value)
-          {
-            best_value = value;
-            *turn = t;
-          }
+          candidates[count].turn = t;
+          candidates[count].bound = turn_bound(player, &t);
+          candidates[count].idx = count;
+          count++;
         }
+
+  qsort(candidates, count, sizeof(Candidate), (int (*)(const void *, const void *))_cmp_candidates);
+
+  float best_value = -1e3;
+  int best_idx = count;
+
+  for (int i = 0; i < count; i++)
+  {
+    Candidate *c = &candidates[i];
+    if (c->bound < best_value || (c->bound == best_value && c->idx > best_idx))
+      break;
+
+    STATS(stats.evaluated++);
+    float value = evaluate_turn(player, &c->turn);
+    if (value > best_value || (value == best_value && c->idx < best_idx))
+    {
+      best_value = value;
+      best_idx = c->idx;
+      *turn = c->turn;
+    }
+  }
+
+#ifdef BOT_STATS
+  stats.candidates = count;
+  stats.bfs_calls = bfs_stats.calls - bfs_start.calls;
+  stats.bfs_cells = bfs_stats.cells - bfs_start.cells;
+  stats.features_ms = time_features - time_start;
+  stats.search_ms = stats_time_ms() - time_features;
+  stats_write(player, remaining);
+#endif
+}
+
+/** Wybiera losowy poprawny ruch i losowe miejsce dla pionka (lub jego brak). Służy jako przeciwnik odniesienia */
+void bot_turn_random(Player *player, Turn *turn, Rng *rng)
+{
+  Turn t = *turn;
+  int count = 0;
+  for (int r = 0; r < 4; r++, tile_rotate(&t.tile))
+    for (t.y = 1; t.y < BOARD_SIZE; t.y++)
+      for (t.x = 1; t.x < BOARD_SIZE; t.x++)
+        if (board_tile_matches(&t.tile, t.x, t.y))
+          candidates[count++].turn = t;
+
+  if (count == 0)
+    return;
+
+  *turn = candidates[rng_below(rng, count)].turn;
+  turn->meeple.color = MeepleNone;
+  if (player->meeple <= 0)
+    return;
+
+  MeepleValidPos valid;
+  Meeple m = {.color = player->color, .pos = TilePosCC};
+  board_tile_tmp(&turn->tile, turn->x, turn->y);
+  board_meeple_valid(&m, turn->x, turn->y, valid);
+  board_tile_tmp(NULL, turn->x, turn->y);
+
+  int options[13], options_count = 0;
+  for (int i = 0; i < 13; i++)
+    if (valid[i])
+      options[options_count++] = i;
+
+  int choice = rng_below(rng, options_count + 1);
+  if (choice < options_count)
+  {
+    turn->meeple.color = player->color;
+    turn->meeple.pos = options[choice];
+  }
 }
@@ -3,7 +3,43 @@
 
 #include "./board.h"
 #include "./game.h"
+#include "./rng.h"
 
-void bot_turn(Player *player, Turn *turn, int remaining);
+/** Rodzaj bota używany w rozgrywkach bez interfejsu */
+typedef uint8_t BotKind;
+enum BotKind
+{
+  BotKindDefault,
+  BotKindRandom,
+  /** Zewnętrzny program (zob. `engine.h`) */
+  BotKindEngine,
+  BotKindCount,
+};
+
+/** Losowość bota pochodzi wyłącznie z generatora gry `rng` */
+void bot_turn(Player *player, Turn *turn, int remaining, Rng *rng);
+void bot_turn_random(Player *player, Turn *turn, Rng *rng);
+
+#ifdef BOT_STATS
+#include <stdio.h>
+
+/**
+ * Statystyki jednej tury bota (tylko z flagą -DBOT_STATS)
+ * candidates - liczba możliwych ruchów, evaluated - ruchy ocenione (nieodrzucone przez ograniczenie),
+ * cache_hits - oceny wzięte z pamięci podręcznej, bfs_* - przejścia BFS i odwiedzone fragmenty płytek,
+ * prob_calls - wywołania `tile_probability`, *_ms - czas oceny obiektów na planszy i przeszukiwania ruchów
+ */
+typedef struct BotStats
+{
+  int candidates, evaluated, cache_hits;
+  uint64_t bfs_calls, bfs_cells, prob_calls;
+  double features_ms, search_ms;
+} BotStats;
+
+/** Statystyki ostatniej tury bota w obecnym wątku */
+BotStats bot_stats();
+/** Po każdej turze zapisuje statystyki do `f` jako jedną linię JSON. NULL wyłącza zapisywanie */
+void bot_stats_log(FILE *f);
+#endif
 
 #endif
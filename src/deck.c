@@ -1,13 +1,14 @@
-#include <stdlib.h>
 #include <string.h>
 
 #include "./deck.h"
 
-static struct Deck
-{
-  Tile tiles[TILE_COUNT];
-  int size;
-} deck;
+/** Stos, na którym działają funkcje modułu (zob. `deck_use()`), osobny dla każdego wątku */
+static _Thread_local Deck deck_own;
+static _Thread_local Deck *deck_active;
+#define deck (*(deck_active ? deck_active : &deck_own))
+
+/** Nowy, nieprzetasowany stos. Płytki są opisane tekstem, więc są tworzone tylko raz w każdym wątku */
+static _Thread_local Deck deck_initial;
 
 #define TILE_ID_HELPER(DEF, IDS, LAST_ID, TYPE, ID)                                                                    \
   {                                                                                                                    \
@@ -18,7 +19,7 @@ static struct Deck
         ['M'] = TileTypeMonastery,                                                                                     \
     };                                                                                                                 \
                                                                                                                        \
-    char *def = DEF;                                                                                                   \
+    const char *def = DEF;                                                                                             \
     if (def[0] == '.')                                                                                                 \
       continue;                                                                                                        \
                                                                                                                        \
@@ -40,7 +41,7 @@ static struct Deck
     FLAGS |= FLAG_MAP[(size_t)FLAG];                                                                                   \
   }
 
-static Tile tile_make(char defs[3 * 13 + 1], char flags[1 + 1], int bitmap)
+static Tile tile_make(const char *defs, const char *flags, int bitmap)
 {
   Tile tile = {0};
   tile.bitmap = bitmap;
@@ -66,10 +67,11 @@ static void deck_swap(int i, int j)
   deck.tiles[i] = tmp;
 }
 
-void deck_shuffle()
+/** Tasowanie Fishera-Yatesa. Płytka startowa trafia na wierzch stosu */
+void deck_shuffle(Rng *rng)
 {
-  for (int i = 0; i < deck.size; i++)
-    deck_swap(i, rand() % deck.size);
+  for (int i = deck.size - 1; i > 0; i--)
+    deck_swap(i, rng_below(rng, i + 1));
 
   for (int i = 0; i < deck.size; i++)
     if (deck.tiles[i].flags & TileFlagStarting)
@@ -95,6 +97,21 @@ Tile *deck_pop()
   return deck.size ? &deck.tiles[--deck.size] : NULL;
 }
 
+void deck_use(Deck *d)
+{
+  deck_active = d;
+}
+
+void deck_save(Deck *d)
+{
+  *d = deck;
+}
+
+void deck_load(const Deck *d)
+{
+  deck = *d;
+}
+
 #define T(C, DU, DR, DD, DL, DC, F, B)                                                                                 \
   {                                                                                                                    \
     tile = tile_make(DU " " DR " " DD " " DL " " DC, F, B);                                                            \
@@ -103,6 +120,12 @@ Tile *deck_pop()
 
 void deck_init()
 {
+  if (deck_initial.size)
+  {
+    deck = deck_initial;
+    return;
+  }
+
   deck.size = 0;
 
   Tile tile;
@@ -132,4 +155,6 @@ void deck_init()
   T(1, "C1 C1 C1", "C1 C1 C1", "F1 R1 F2", "C1 C1 C1", "C1", ".", 21);
   T(2, "C1 C1 C1", "C1 C1 C1", "F1 R1 F2", "C1 C1 C1", "C1", "P", 22);
   T(1, "C1 C1 C1", "C1 C1 C1", "C1 C1 C1", "C1 C1 C1", "C1", "P", 23);
+
+  deck_initial = deck;
 }
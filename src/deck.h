@@ -2,12 +2,25 @@
 #define __deck_inc
 
 #include "./board.h"
+#include "./rng.h"
+
+typedef struct Deck
+{
+  Tile tiles[TILE_COUNT];
+  int size;
+} Deck;
 
 void deck_init();
 void deck_deinit();
-void deck_shuffle();
+void deck_shuffle(Rng *rng);
 void deck_push(int count, Tile *t);
 int deck_size();
 Tile *deck_pop();
 
+/** Ustawia stos, na którym działają funkcje modułu w obecnym wątku. NULL - własny stos wątku */
+void deck_use(Deck *d);
+/** Kopiuje stos razem z kolejnością płytek */
+void deck_save(Deck *d);
+void deck_load(const Deck *d);
+
 #endif
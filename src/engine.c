@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "./board.h"
+#include "./engine.h"
+#include "./match.h"
+
+/** Czas na powitanie i na zakończenie silnika */
+#define ENGINE_START_MS 5000
+#define ENGINE_STOP_MS 1000
+
+static double engine_time_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/** Czyta jedną linię od silnika. Zwraca false po upływie `deadline` albo gdy silnik zamknął potok */
+static bool engine_read_line(Engine *e, char *line, size_t size, double deadline)
+{
+  for (;;)
+  {
+    char *end = memchr(e->buf, '\n', e->buf_len);
+    if (end)
+    {
+      size_t len = end - e->buf;
+      size_t n = len < size - 1 ? len : size - 1;
+      memcpy(line, e->buf, n);
+      line[n] = '\0';
+      e->buf_len -= len + 1;
+      memmove(e->buf, end + 1, e->buf_len);
+      return true;
+    }
+
+    // Zbyt długa linia nie jest poprawną odpowiedzią
+    if (e->buf_len == sizeof(e->buf))
+      e->buf_len = 0;
+
+    int wait = deadline - engine_time_ms();
+    struct pollfd p = {.fd = e->from, .events = POLLIN};
+    int ready = poll(&p, 1, wait > 0 ? wait : 0);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return false;
+
+    ssize_t n = read(e->from, e->buf + e->buf_len, sizeof(e->buf) - e->buf_len);
+    if (n <= 0)
+      return false;
+    e->buf_len += n;
+  }
+}
+
+bool engine_start(Engine *e, const char *cmd)
+{
+  memset(e, 0, sizeof(Engine));
+  e->from = -1;
+
+  // Zamknięty silnik nie może zakończyć całego programu sygnałem przy zapisie do potoku
+  signal(SIGPIPE, SIG_IGN);
+
+  // Potoki nie mogą być dziedziczone przez silniki uruchamiane w innych wątkach
+  int to[2], from[2];
+  if (pipe2(to, O_CLOEXEC))
+    return false;
+  if (pipe2(from, O_CLOEXEC))
+  {
+    close(to[0]);
+    close(to[1]);
+    return false;
+  }
+
+  e->pid = fork();
+  if (e->pid == 0)
+  {
+    dup2(to[0], STDIN_FILENO);
+    dup2(from[1], STDOUT_FILENO);
+    execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+    _exit(127);
+  }
+
+  close(to[0]);
+  close(from[1]);
+  e->to = fdopen(to[1], "w");
+  e->from = from[0];
+  if (e->pid < 0 || !e->to)
+  {
+    engine_stop(e);
+    return false;
+  }
+
+  fprintf(e->to, "carcassonne 1\n");
+  fflush(e->to);
+
+  char line[64];
+  if (!engine_read_line(e, line, sizeof(line), engine_time_ms() + ENGINE_START_MS) || strncmp(line, "ready", 5))
+  {
+    engine_stop(e);
+    return false;
+  }
+
+  snprintf(e->name, sizeof(e->name), "%.31s", line[5] == ' ' ? line + 6 : "engine");
+  return true;
+}
+
+void engine_stop(Engine *e)
+{
+  if (e->to)
+  {
+    fprintf(e->to, "quit\n");
+    fclose(e->to);
+  }
+  if (e->from >= 0)
+    close(e->from);
+
+  if (e->pid > 0)
+  {
+    // Silnik, który nie kończy się po `quit`, jest zabijany
+    int status;
+    double deadline = engine_time_ms() + ENGINE_STOP_MS;
+    while (!waitpid(e->pid, &status, WNOHANG) && engine_time_ms() < deadline)
+      usleep(1000);
+    if (!waitpid(e->pid, &status, WNOHANG))
+    {
+      kill(e->pid, SIGKILL);
+      waitpid(e->pid, &status, 0);
+    }
+  }
+
+  e->to = NULL;
+  e->from = -1;
+  e->pid = 0;
+}
+
+void engine_new_game(Engine *e, int seat)
+{
+  static _Thread_local Board b;
+  board_save(&b);
+
+  fprintf(e->to, "newgame %d %d\n", match.count, seat);
+  for (int i = 0; i < b.tile_count; i++)
+  {
+    Tile *t = &b.tiles[i];
+    fprintf(e->to, "place %d %d %d %d %d %d\n", b.pos[i][0], b.pos[i][1], t->bitmap, t->rot, t->meeple.color,
+            t->meeple.pos);
+  }
+}
+
+void engine_observe(Engine *e, const Turn *turn)
+{
+  if (turn->skip)
+    fprintf(e->to, "skip %d %d\n", match.index, turn->tile.bitmap);
+  else
+    fprintf(e->to, "move %d %d %d %d %d %d\n", match.index, turn->tile.bitmap, turn->x, turn->y, turn->tile.rot,
+            turn->meeple.color == MeepleNone ? -1 : turn->meeple.pos);
+}
+
+void engine_points(Engine *e)
+{
+  fprintf(e->to, match.finished ? "gameover" : "points");
+  for (int i = 0; i < match.count; i++)
+    fprintf(e->to, " %u", match.players[i].points);
+  fprintf(e->to, "\n");
+
+  if (match.finished)
+    fflush(e->to);
+}
+
+/** Możliwy ruch: pozycja, obrót i pozycje, na których można postawić podwładnego */
+typedef struct EngineMove
+{
+  uint8_t x, y, rot;
+  uint16_t meeple;
+} EngineMove;
+
+/** Wszystkie możliwe ruchy w obecnym ruchu. Zwraca ich liczbę */
+static int engine_moves(Turn *turn, EngineMove *moves)
+{
+  int count = 0;
+  bool meeple = match_current()->meeple > 0;
+  Tile tile = turn->tile;
+
+  for (int r = 0; r < 4; r++, tile_rotate(&tile))
+    for (int y = 1; y < BOARD_SIZE; y++)
+      for (int x = 1; x < BOARD_SIZE; x++)
+        if (board_tile_matches(&tile, x, y))
+        {
+          EngineMove *m = &moves[count++];
+          m->x = x;
+          m->y = y;
+          m->rot = r;
+          m->meeple = 0;
+          if (!meeple)
+            continue;
+
+          MeepleValidPos valid;
+          Meeple mp = {.color = match_current()->color, .pos = TilePosCC};
+          board_tile_tmp(&tile, x, y);
+          board_meeple_valid(&mp, x, y, valid);
+          board_tile_tmp(NULL, x, y);
+          for (int i = 0; i < 13; i++)
+            m->meeple |= valid[i] << i;
+        }
+
+  return count;
+}
+
+void engine_turn(Engine *e, Turn *turn, int time_ms)
+{
+  // Płytka ma co najwyżej 4 sąsiednie pola dla każdej wyłożonej płytki, w każdym z 4 obrotów
+  static _Thread_local EngineMove moves[TILE_COUNT * 4 * 4];
+  int count = engine_moves(turn, moves);
+
+  unsigned int id = ++e->go_id;
+  fprintf(e->to, "go %u %d %d %d", id, turn->tile.bitmap, time_ms, count);
+  for (int i = 0; i < count; i++)
+    fprintf(e->to, " %d %d %d %d", moves[i].x, moves[i].y, moves[i].rot, moves[i].meeple);
+  fprintf(e->to, "\n");
+  fflush(e->to);
+
+  // Odpowiedzi na poprzednie `go` (po przekroczeniu czasu) są pomijane
+  char line[64];
+  unsigned int reply;
+  int x, y, rot, meeple, move = -1;
+  double deadline = engine_time_ms() + time_ms;
+  while (engine_read_line(e, line, sizeof(line), deadline))
+    if (sscanf(line, "play %u %d %d %d %d", &reply, &x, &y, &rot, &meeple) == 5 && reply == id)
+    {
+      for (int i = 0; i < count && move < 0; i++)
+        if (moves[i].x == x && moves[i].y == y && moves[i].rot == rot &&
+            (meeple == -1 || (meeple >= 0 && meeple < 13 && moves[i].meeple >> meeple & 1)))
+          move = i;
+      break;
+    }
+
+  if (move < 0)
+  {
+    e->errors++;
+    move = 0;
+    meeple = -1;
+  }
+
+  for (int i = 0; i < moves[move].rot; i++)
+    tile_rotate(&turn->tile);
+  turn->x = moves[move].x;
+  turn->y = moves[move].y;
+  turn->meeple.color = meeple < 0 ? MeepleNone : match_current()->color;
+  turn->meeple.pos = meeple < 0 ? TilePosCC : meeple;
+}
@@ -0,0 +1,56 @@
+#ifndef __engine_inc
+#define __engine_inc
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "./game.h"
+
+/**
+ * Zewnętrzny gracz (silnik) - dowolny program, z którym gra rozmawia przez stdin/stdout protokołem tekstowym,
+ * podobnym do UCI w szachach. Jedna komenda w linii, liczby oddzielone spacjami. Gra wysyła:
+ *
+ *   carcassonne 1                       - powitanie, silnik odpowiada `ready nazwa`
+ *   newgame gracze miejsce              - nowa gra, `miejsce` to numer silnika przy stole
+ *   place x y płytka rot kolor pozycja  - płytka leżąca już na planszy (na początku gry, także płytka startowa)
+ *   move miejsce płytka x y rot meeple  - ruch dowolnego gracza (także silnika), meeple -1 - bez podwładnego
+ *   skip miejsce płytka                 - płytki nie dało się nigdzie położyć
+ *   points p0 p1 ...                    - punkty po ruchu
+ *   go id płytka ms n x y rot maska ... - ruch silnika: wylosowana płytka, limit czasu i `n` możliwych ruchów.
+ *                                         Bity maski to pozycje (0-12), na których można postawić podwładnego
+ *   gameover p0 p1 ...                  - koniec gry
+ *   quit
+ *
+ * Silnik odpowiada na `go` linią `play id x y rot meeple`. Płytki to numery bitmap (jak w zapisie gry), `rot`
+ * to liczba obrotów wylosowanej płytki. Wszystko poza `go` jest tylko buforowane i wysyłane razem z `go`,
+ * więc jeden ruch to jeden zapis i jeden odczyt z potoku. Odpowiedź spóźniona albo niepoprawna jest liczona
+ * jako błąd silnika i zastępowana pierwszym możliwym ruchem bez podwładnego.
+ */
+typedef struct Engine
+{
+  pid_t pid;
+  FILE *to;
+  int from;
+  char name[32];
+  char buf[256];
+  int buf_len;
+  /** Numer ostatniego `go`. Odpowiedzi z innym numerem (spóźnione) są pomijane */
+  unsigned int go_id;
+  int errors;
+} Engine;
+
+/** Uruchamia `cmd` przez `/bin/sh -c` i czeka na powitanie. Zwraca false, jeżeli silnik nie odpowiada */
+bool engine_start(Engine *e, const char *cmd);
+void engine_stop(Engine *e);
+
+/** Rozpoczyna grę i wysyła płytki leżące na planszy. Wywoływane po ustawieniu stanu gry w obecnym wątku */
+void engine_new_game(Engine *e, int seat);
+/** Przekazuje ruch obecnego gracza. Wywoływane przed `match_turn_end()` */
+void engine_observe(Engine *e, const Turn *turn);
+/** Przekazuje punkty po ruchu albo na koniec gry. Wywoływane po `match_turn_end()` */
+void engine_points(Engine *e);
+
+/** Ruch silnika w `turn` (jak `bot_turn`). Płytkę musi dać się gdzieś położyć */
+void engine_turn(Engine *e, Turn *turn, int time_ms);
+
+#endif
@@ -4,9 +4,13 @@
 #include "./bot.h"
 #include "./deck.h"
 #include "./game.h"
-#include "./points.h"
+#include "./match.h"
+#include "./particles.h"
+#include "./profile.h"
 #include "./resources.h"
+#include "./snapshot.h"
 #include "./spring.h"
+#include "./text.h"
 #include "./utils.h"
 
 #define PLAYER_COUNT MEEPLE_COLOR_COUNT
@@ -16,8 +20,9 @@
 
 static void state_finish();
 static void state_turn_start();
-static void state_turn_end();
 static void state_turn_skip();
+static void state_turn_place();
+static void state_turn_end();
 
 static void player_turn_start();
 static void player_turn_end();
@@ -26,24 +31,13 @@ static void player_turn_meeple();
 // Globals
 
 /**
- * Lista wszystkich graczy, liczba graczy i aktywny gracz.
- */
-static struct Players
-{
-  Player all[PLAYER_COUNT];
-  Player *current;
-  int count, index;
-} players;
-
-/**
- * Stan gry
+ * Stan gry. Gracze i obecny ruch są przechowywani w module `match`
  */
 static struct State
 {
   bool started : 1;
   bool finished : 1;
   bool paused : 1;
-  Turn turn;
 } state;
 
 /**
@@ -54,144 +48,196 @@ static GameConfig cfg;
 // Helpers
 
 /**
- * Animacje zdobywania punktów
+ * Animacje zdobywania punktów: lecące monety i stopniowo rosnące punkty graczy
  */
-#define NUM_COINS 20
 static struct Coins
 {
-  bool part_a[NUM_COINS];
-  Spring part_s[NUM_COINS];
-  float part_v[NUM_COINS][6];
-  int part_idx;
+  Particles particles;
+  SpringPool springs;
   Spring points[PLAYER_COUNT];
 } coins;
 
 /**
- * Zdobywanie punktów
+ * Animacja zdobywania punktów
  */
-static void game_collect_points_cb(int points, MeepleCounts meeple, CollectMeeplePos meeple_pos)
+static void game_score_cb(int i, int points, TileType type, int x, int y)
 {
-  int max = 0;
-  for (int i = 0; i <= MEEPLE_COLOR_COUNT; i++)
-    if (max < meeple[i])
-      max = meeple[i];
+  UNUSED2(points, type);
+  float target = match.players[i].points + 0.5;
+  spring_set_target(&coins.springs, coins.points[i], target);
 
-  for (int i = 0; i < players.count; i++)
+  if (cfg.turbo)
   {
-    struct Player *player = &players.all[i];
-    player->meeple += meeple[player->color];
-    if (max == 0 || meeple[player->color] != max)
-      continue;
-
-    player->points += points;
-    coins.points[i].target = player->points + 0.5;
-
-    int ci = coins.part_idx = (coins.part_idx + 1) % NUM_COINS;
-    coins.part_a[ci] = true;
-    coins.part_s[ci].value = 0;
-    coins.part_s[ci].target = 1;
-    coins.part_s[ci].velocity = 0;
-    coins.part_v[ci][0] = (view.x + meeple_pos[player->color][0] - 0.5) * view.s;
-    coins.part_v[ci][1] = GAME_UI_S * 1.5;
-    coins.part_v[ci][2] = (view.y + meeple_pos[player->color][1] - 0.5) * view.s;
-    coins.part_v[ci][3] = GAME_UI_S * i;
-    coins.part_v[ci][4] = view.s;
-    coins.part_v[ci][5] = GAME_UI_S;
+    spring_jump(&coins.springs, coins.points[i], target);
+    return;
   }
+
+  particles_emit(&coins.particles, (view.x + x - 0.5) * view.s, (view.y + y - 0.5) * view.s, view.s, GAME_UI_S * 1.5,
+                 GAME_UI_S * i, GAME_UI_S);
 }
 
 /**
- * Funkcje, które nie wykonują się od razu, tylko po pewnym czasie
+ * Napisy panelu graczy: liczba podwładnych i punkty każdego gracza oraz liczba pozostałych płytek.
+ * Są rysowane na nowo tylko po zmianie wartości
+ */
+static struct HudText
+{
+  TextCache meeple[PLAYER_COUNT];
+  TextCache points[PLAYER_COUNT];
+  TextCache turns;
+} hud;
+
+// Events
+
+/**
+ * Kroki gry. Każde zdarzenie przeprowadza grę do kolejnego stanu i planuje następne zdarzenie
  */
-static struct Timeout
+typedef enum GameEvent
 {
-  void (*cb)();
-  float seconds;
-} timeout;
+  GameEventTurnStart,
+  GameEventTurnSkip,
+  /** Położenie kafelka i pionka oraz liczenie punktów */
+  GameEventTurnPlace,
+  GameEventTurnEnd,
+  GameEventFinish,
+} GameEvent;
+
+static void (*const EVENT_HANDLERS[])() = {
+    [GameEventTurnStart] = state_turn_start, [GameEventTurnSkip] = state_turn_skip,
+    [GameEventTurnPlace] = state_turn_place, [GameEventTurnEnd] = state_turn_end,
+    [GameEventFinish] = state_finish,
+};
+
+#define EVENT_QUEUE_SIZE 8
 
-static void set_timeout(void (*cb)(), float seconds)
+/**
+ * Kolejka zaplanowanych zdarzeń, posortowana po czasie. Czas gry płynie tylko wtedy, gdy gra nie jest
+ * zatrzymana, a wszystkie zdarzenia, na które przyszedł czas, wykonują się niezależnie od liczby klatek
+ */
+static struct EventQueue
+{
+  struct
+  {
+    GameEvent kind;
+    double at;
+  } items[EVENT_QUEUE_SIZE];
+  int count;
+  double now;
+} events;
+
+/** Planuje zdarzenie za `seconds` sekund. W trybie turbo kolejne kroki gry wykonują się bez przerw */
+static void event_push(GameEvent kind, float seconds)
 {
-  timeout.seconds = seconds;
-  timeout.cb = cb;
+  ASSERTF((events.count < EVENT_QUEUE_SIZE), "event queue overflow");
+
+  double at = events.now + (cfg.turbo ? 0 : seconds);
+  int i = events.count++;
+  for (; i > 0 && events.items[i - 1].at > at; i--)
+    events.items[i] = events.items[i - 1];
+
+  events.items[i].kind = kind;
+  events.items[i].at = at;
 }
 
-// State
+/**
+ * Wykonuje zdarzenia, na które przyszedł czas, dopóki nie minie `deadline` (czas z `al_get_time()`).
+ * Zwraca true, jeżeli wykonało się jakieś zdarzenie
+ */
+static bool events_run(double deadline)
+{
+  bool ran = false;
+  while (state.started && !state.paused && events.count > 0 && events.items[0].at <= events.now &&
+         al_get_time() < deadline)
+  {
+    GameEvent kind = events.items[0].kind;
+    memmove(&events.items[0], &events.items[1], --events.count * sizeof(events.items[0]));
+    EVENT_HANDLERS[kind]();
+    ran = true;
+  }
+  return ran;
+}
 
-static int _cmp_players(const Player *a, const Player *b)
+/** Ustawia widok na obecny ruch. W trybie turbo bez animacji */
+static void view_turn()
 {
-  return b->points - a->points;
+  view_set(-match.turn.x, -match.turn.y);
+  if (cfg.turbo)
+    view_snap();
 }
 
+// State
+
 static void state_finish()
 {
   state.finished = true;
 
-  GameResults results = {0};
-  results.count = players.count;
-  for (int i = 0; i < players.count; i++)
-    results.players[i] = players.all[i];
+  if (cfg.replay)
+  {
+    replay_save(&match.replay, cfg.replay);
+    fflush(cfg.replay);
+  }
 
-  qsort(&results.players, players.count, sizeof(Player), (int (*)(const void *, const void *))_cmp_players);
-  cfg.on_finish(results);
+  cfg.on_finish(match_results());
 }
 
 static void state_turn_start()
 {
-  state.turn.active = true;
-  players.index = (players.index + 1) % players.count;
-  players.current = &players.all[players.index];
-  state.turn.tile = *deck_pop();
-  state.turn.meeple.color = players.current->color;
-  state.turn.meeple.pos = TilePosCC;
-  view_set(-state.turn.x, -state.turn.y);
-
-  if (!board_tile_valid(&state.turn.tile))
-    set_timeout(state_turn_skip, 1.0);
-  else if (players.current->bot)
+  bool valid = match_turn_start();
+  view_turn();
+
+  if (!valid)
+    event_push(GameEventTurnSkip, 1.0);
+  else if (match_current()->bot)
   {
-    bot_turn(players.current, &state.turn, deck_size() / players.count);
-    view_set(-state.turn.x, -state.turn.y);
-    set_timeout(state_turn_end, 1.0);
+    bot_turn(match_current(), &match.turn, deck_size() / match.count, &match.rng);
+    view_turn();
+    event_push(GameEventTurnPlace, 1.0);
   }
   else
     player_turn_start();
 }
 
-static void state_turn_end()
+static void state_turn_skip()
 {
-  state.turn.active = false;
-  if (state.turn.skip)
-    state.turn.skip = false;
-  else
-  {
-    board_tile_place(&state.turn.tile, state.turn.x, state.turn.y);
-    if (state.turn.meeple.color != MeepleNone)
-    {
-      board_meeple_place(&state.turn.meeple, state.turn.x, state.turn.y);
-      players.current->meeple--;
-    }
-  }
+  match.turn.skip = true;
+  event_push(GameEventTurnPlace, 0);
+}
 
-  if (deck_size() == 0)
+static void state_turn_place()
+{
+  match_turn_end();
+  event_push(GameEventTurnEnd, 0);
+}
+
+static void state_turn_end()
+{
+  if (match.finished)
   {
-    collect_all_points(true, game_collect_points_cb);
-    set_timeout(state_finish, 5.0);
+    event_push(GameEventFinish, 5.0);
     view_blur();
     return;
   }
 
-  collect_points(state.turn.x, state.turn.y, false, game_collect_points_cb);
-
-  if (players.current->bot)
-    set_timeout(state_turn_start, 1.0);
-  else
-    state_turn_start();
+  event_push(GameEventTurnStart, match_current()->bot ? 1.0 : 0);
 }
 
-void state_turn_skip()
+/**
+ * Kontynuuje wczytaną grę. Ruch bota był już wybrany przed zapisem, a gracz zaczyna swój ruch od początku
+ */
+static void state_resume()
 {
-  state.turn.skip = true;
-  state_turn_end();
+  view_turn();
+
+  if (match.finished)
+    event_push(GameEventFinish, 1.0);
+  else if (!match.turn.active)
+    event_push(GameEventTurnStart, 0);
+  else if (!board_tile_valid(&match.turn.tile))
+    event_push(GameEventTurnSkip, 1.0);
+  else if (match_current()->bot)
+    event_push(GameEventTurnPlace, 1.0);
+  else
+    player_turn_start();
 }
 
 // Player turn
@@ -220,19 +266,19 @@ static void player_turn_start()
 static void player_turn_end()
 {
   p_turn.active = false;
-  state_turn_end();
+  event_push(GameEventTurnPlace, 0);
 }
 
 static void player_turn_meeple()
 {
   p_turn.phase = TurnPhaseMeeple;
-  if (players.current->meeple <= 0)
+  if (match_current()->meeple <= 0)
   {
-    state.turn.meeple.color = MeepleNone;
+    match.turn.meeple.color = MeepleNone;
     player_turn_end();
   }
   else
-    board_meeple_valid(&state.turn.meeple, state.turn.x, state.turn.y, p_turn.meeple_valid_pos);
+    board_meeple_valid(&match.turn.meeple, match.turn.x, match.turn.y, p_turn.meeple_valid_pos);
 }
 
 // User interaction
@@ -242,30 +288,30 @@ static void keydown_tile(int code)
   switch (code)
   {
   case ALLEGRO_KEY_UP:
-    state.turn.y--;
+    match.turn.y--;
     break;
   case ALLEGRO_KEY_DOWN:
-    state.turn.y++;
+    match.turn.y++;
     break;
   case ALLEGRO_KEY_LEFT:
-    state.turn.x--;
+    match.turn.x--;
     break;
   case ALLEGRO_KEY_RIGHT:
-    state.turn.x++;
+    match.turn.x++;
     break;
   case ALLEGRO_KEY_SPACE:
-    tile_rotate(&state.turn.tile);
+    tile_rotate(&match.turn.tile);
     break;
   case ALLEGRO_KEY_ENTER:
-    if (board_tile_matches(&state.turn.tile, state.turn.x, state.turn.y))
+    if (board_tile_matches(&match.turn.tile, match.turn.x, match.turn.y))
     {
-      board_tile_tmp(&state.turn.tile, state.turn.x, state.turn.y);
+      board_tile_tmp(&match.turn.tile, match.turn.x, match.turn.y);
       player_turn_meeple();
     }
   }
 
-  p_turn.tile_valid_pos = board_tile_matches(&state.turn.tile, state.turn.x, state.turn.y);
-  view_set(-state.turn.x, -state.turn.y);
+  p_turn.tile_valid_pos = board_tile_matches(&match.turn.tile, match.turn.x, match.turn.y);
+  view_set(-match.turn.x, -match.turn.y);
 }
 
 static void keydown_meeple(int code)
@@ -289,23 +335,23 @@ static void keydown_meeple(int code)
   switch (code)
   {
   case ALLEGRO_KEY_UP:
-    state.turn.meeple.pos = POS_MAP[state.turn.meeple.pos][0];
+    match.turn.meeple.pos = POS_MAP[match.turn.meeple.pos][0];
     break;
   case ALLEGRO_KEY_RIGHT:
-    state.turn.meeple.pos = POS_MAP[state.turn.meeple.pos][1];
+    match.turn.meeple.pos = POS_MAP[match.turn.meeple.pos][1];
     break;
   case ALLEGRO_KEY_DOWN:
-    state.turn.meeple.pos = POS_MAP[state.turn.meeple.pos][2];
+    match.turn.meeple.pos = POS_MAP[match.turn.meeple.pos][2];
     break;
   case ALLEGRO_KEY_LEFT:
-    state.turn.meeple.pos = POS_MAP[state.turn.meeple.pos][3];
+    match.turn.meeple.pos = POS_MAP[match.turn.meeple.pos][3];
     break;
   case ALLEGRO_KEY_BACKSPACE:
-    state.turn.meeple.color = MeepleNone;
+    match.turn.meeple.color = MeepleNone;
     player_turn_end();
     break;
   case ALLEGRO_KEY_ENTER:
-    if (p_turn.meeple_valid_pos[state.turn.meeple.pos])
+    if (p_turn.meeple_valid_pos[match.turn.meeple.pos])
       player_turn_end();
     break;
   }
@@ -317,7 +363,11 @@ void game_keydown(int code)
     return;
 
   if (p_turn.active)
+  {
     p_turn.phase == TurnPhaseTile ? keydown_tile(code) : keydown_meeple(code);
+    // Ruch gracza kończy się od razu, bez czekania na następną klatkę
+    events_run(al_get_time() + TURBO_FRAME_BUDGET);
+  }
 
   switch (code)
   {
@@ -337,48 +387,70 @@ void game_pause(bool pause)
   state.paused = pause;
 }
 
-void game_init(GameConfig config)
+static void game_start(GameConfig config)
 {
   cfg = config;
 
-  deck_init();
-  board_init();
-  deck_shuffle();
+  match_init(cfg.players, cfg.bots, cfg.seed, game_score_cb);
 
-  memset(&players, 0, sizeof(players));
   memset(&state, 0, sizeof(state));
   memset(&coins, 0, sizeof(coins));
-  memset(&timeout, 0, sizeof(timeout));
+  memset(&events, 0, sizeof(events));
   memset(&p_turn, 0, sizeof(p_turn));
 
-  players.count = cfg.players + cfg.bots;
-  for (int i = 0; i < players.count; i++)
-  {
-    players.all[i].color = (MeepleColor)(i + 1);
-    players.all[i].meeple = 7;
-    players.all[i].points = 0;
-  }
+  for (int i = 0; i < PLAYER_COUNT; i++)
+    coins.points[i] = spring_add(&coins.springs, 1, 2);
 
-  for (int i = 0; i < cfg.bots; i++)
-    players.all[players.count - i - 1].bot = true;
+  state.started = true;
+  view_focus();
+}
 
-  state.turn.x = state.turn.y = BOARD_CENTER;
-  board_tile_place(deck_pop(), state.turn.x, state.turn.y);
+void game_init(GameConfig config)
+{
+  game_start(config);
+  event_push(GameEventTurnStart, 0);
+  events_run(al_get_time() + TURBO_FRAME_BUDGET);
+}
 
-  for (int i = 0; i < NUM_COINS; i++)
-    spring_init(&coins.part_s[i], 1.5, 1);
+bool game_save(FILE *f)
+{
+  if (!state.started)
+    return false;
 
-  for (int i = 0; i < PLAYER_COUNT; i++)
-    spring_init(&coins.points[i], 1, 2);
+  Snapshot s;
+  snapshot_take(&s);
+  return snapshot_write(&s, f);
+}
 
-  players.index = -1;
-  state.started = true;
-  view_focus();
-  state_turn_start();
+bool game_load(GameConfig config, FILE *f)
+{
+  Snapshot s;
+  if (!snapshot_read(&s, f))
+    return false;
+
+  game_start(config);
+  snapshot_restore(&s);
+
+  for (int i = 0; i < match.count; i++)
+  {
+    spring_set_target(&coins.springs, coins.points[i], match.players[i].points + 0.5);
+    spring_jump(&coins.springs, coins.points[i], match.players[i].points + 0.5);
+  }
+
+  state_resume();
+  events_run(al_get_time() + TURBO_FRAME_BUDGET);
+  return true;
 }
 
 void game_deinit()
 {
+  for (int i = 0; i < PLAYER_COUNT; i++)
+  {
+    text_free(&hud.meeple[i]);
+    text_free(&hud.points[i]);
+  }
+  text_free(&hud.turns);
+
   board_deinit();
   state.started = false;
   view_blur();
@@ -386,31 +458,19 @@ void game_deinit()
 
 // Update and render
 
-void game_tick(float dt)
+bool game_tick(float dt, double deadline)
 {
   if (!state.started || state.paused)
-    return;
-
-  if (timeout.seconds <= 0 && timeout.cb)
-  {
-    void (*cb)() = timeout.cb;
-    timeout.cb = NULL;
-    cb();
-  }
+    return false;
 
-  if (timeout.seconds > 0)
-    timeout.seconds -= dt;
+  // W trybie turbo w jednej klatce wykonuje się tyle kroków gry, ile zmieści się w TURBO_FRAME_BUDGET,
+  // a rysowany jest tylko stan po ostatnim z nich. Termin jest wspólny dla wszystkich kroków symulacji w klatce
+  events.now += dt;
+  bool changed = events_run(deadline);
 
-  for (int i = 0; i < NUM_COINS; i++)
-    if (coins.part_a[i])
-    {
-      spring_update(&coins.part_s[i], dt);
-      if (spring_at_rest(&coins.part_s[i]))
-        coins.part_a[i] = false;
-    }
-
-  for (int i = 0; i < PLAYER_COUNT; i++)
-    spring_update(&coins.points[i], dt);
+  changed |= particles_update(&coins.particles, dt);
+  changed |= spring_pool_update(&coins.springs, dt);
+  return changed;
 }
 
 void game_render(float w, float h)
@@ -419,60 +479,56 @@ void game_render(float w, float h)
   float bx = w / 2 + view.x * bs;
   float by = h / 2 + view.y * bs;
 
-  board_render(bx, by, bs);
+  board_render(bx, by, bs, w, h);
 
   if (!state.started)
     return;
 
-  float tx = bx + state.turn.x * bs, ty = by + state.turn.y * bs;
+  float tx = bx + match.turn.x * bs, ty = by + match.turn.y * bs;
 
   if (p_turn.active)
   {
     if (p_turn.phase == TurnPhaseTile)
-      tile_render(&state.turn.tile, tx, ty, bs, RenderFlagHighlight | (p_turn.tile_valid_pos ? 0 : RenderFlagFaded));
+      tile_render(&match.turn.tile, tx, ty, bs, RenderFlagHighlight | (p_turn.tile_valid_pos ? 0 : RenderFlagFaded));
     else
-      meeple_render(&state.turn.meeple, tx, ty, bs,
-                    p_turn.meeple_valid_pos[state.turn.meeple.pos] ? 0 : RenderFlagFaded);
+      meeple_render(&match.turn.meeple, tx, ty, bs,
+                    p_turn.meeple_valid_pos[match.turn.meeple.pos] ? 0 : RenderFlagFaded);
   }
 
-  for (int i = 0; i < NUM_COINS; i++)
-    if (coins.part_a[i])
-    {
-      float cv = coins.part_s[i].value;
-      float cx = (coins.part_v[i][0] + w / 2) * (1 - cv) + coins.part_v[i][1] * cv;
-      float cy = (coins.part_v[i][2] + h / 2) * (1 - cv) + coins.part_v[i][3] * cv;
-      float cs = coins.part_v[i][4] * (1 - cv) + coins.part_v[i][5] * cv;
-      al_draw_tinted_scaled_bitmap(bitmaps.coin, al_map_rgba_f(1 - cv, 1 - cv, 1 - cv, 1 - cv), 0, 0, BMP_MEEPLE_S,
-                                   BMP_MEEPLE_S, cx, cy, cs, cs, 0);
-    }
+  particles_render(&coins.particles, w, h);
 
   al_hold_bitmap_drawing(true);
 
   if (!state.finished)
   {
-    for (int i = 0; i < players.count; i++)
+    for (int i = 0; i < match.count; i++)
     {
-      Player *player = &players.all[i];
+      Player *player = &match.players[i];
 
       ALLEGRO_BITMAP *bitmap = bitmaps.player_state[player->color - 1];
 
       float uy = i * GAME_UI_S;
 
       al_draw_scaled_bitmap(bitmap, 0, 0, BMP_UI_S * 3 - 1, BMP_UI_S, 0, 0 + uy, GAME_UI_S * 3, GAME_UI_S, 0);
-      al_draw_textf(fonts.ui, al_map_rgb_f(1, 1, 1), GAME_UI_S * 1.05, uy + GAME_UI_S * 0.5 - FONT_SIZE * 0.55,
-                    ALLEGRO_ALIGN_CENTER, "%d", player->meeple);
-      al_draw_textf(fonts.ui, al_map_rgb_f(1, 1, 1), GAME_UI_S * 2.0, uy + GAME_UI_S * 0.5 - FONT_SIZE * 0.55,
-                    ALLEGRO_ALIGN_CENTER, "%d", (int)coins.points[i].value);
-
-      if (i == players.index)
+      PROFILE_DRAW(1);
+      text_draw_int(&hud.meeple[i], GAME_UI_S * 1.05, uy + GAME_UI_S * 0.5 - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER,
+                    player->meeple);
+      text_draw_int(&hud.points[i], GAME_UI_S * 2.0, uy + GAME_UI_S * 0.5 - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER,
+                    (int)spring_value(&coins.springs, coins.points[i]));
+
+      if (i == match.index)
+      {
         al_draw_scaled_bitmap(bitmaps.player_state_a, 0, 0, BMP_UI_S * 3 - 1, BMP_UI_S, 0, 0 + uy, GAME_UI_S * 3,
                               GAME_UI_S, 0);
+        PROFILE_DRAW(1);
+      }
     }
 
     al_draw_scaled_bitmap(bitmaps.turns_left, 0, 0, 2 * BMP_UI_S, BMP_UI_S, w - GAME_UI_S * 2, 0, GAME_UI_S * 2,
                           GAME_UI_S, 0);
-    al_draw_textf(fonts.ui, al_map_rgb_f(1, 1, 1), w - GAME_UI_S * 0.65, GAME_UI_S * 0.5 - FONT_SIZE * 0.55,
-                  ALLEGRO_ALIGN_CENTER, "%d", deck_size() + (state.turn.active ? 1 : 0));
+    PROFILE_DRAW(1);
+    text_draw_int(&hud.turns, w - GAME_UI_S * 0.65, GAME_UI_S * 0.5 - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER,
+                  deck_size() + (match.turn.active ? 1 : 0));
   }
 
   al_hold_bitmap_drawing(false);
@@ -1,6 +1,8 @@
 #ifndef __game_inc
 #define __game_inc
 
+#include <stdio.h>
+
 #include "./board.h"
 
 typedef struct Turn
@@ -29,14 +31,35 @@ typedef struct GameConfig
 {
   int players;
   int bots;
+  /** Ziarno generatora gry */
+  uint64_t seed;
+  /** Plik, do którego dopisywany jest zapis skończonej gry (może być NULL) */
+  FILE *replay;
+  /**
+   * Tryb turbo: brak przerw między ruchami botów, kilka ruchów w jednej klatce i brak animacji.
+   * Ruchy graczy nie są przyspieszane
+   */
+  bool turbo;
   void (*on_finish)(GameResults results);
 } GameConfig;
 
 void game_init(GameConfig cfg);
 void game_deinit();
 
+/** Zapisuje stan trwającej gry do pliku (zob. `snapshot.h`) */
+bool game_save(FILE *f);
+/** Wczytuje grę z pliku i ją kontynuuje. Liczba graczy i ziarno w `cfg` są ignorowane */
+bool game_load(GameConfig cfg, FILE *f);
+
 void game_keydown(int code);
-void game_tick(float dt);
+/** Czas (w sekundach), jaki w trybie turbo można w jednej klatce poświęcić na ruchy botów */
+#define TURBO_FRAME_BUDGET 0.012
+
+/**
+ * Krok gry o `dt`. Ruchy botów są wykonywane tylko do `deadline` (`al_get_time()`), wspólnego dla wszystkich
+ * kroków w jednej klatce. Zwraca true, jeżeli stan gry albo animacje się zmieniły i trzeba narysować nową klatkę
+ */
+bool game_tick(float dt, double deadline);
 void game_render(float w, float h);
 
 void game_pause(bool pause);
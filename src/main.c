@@ -2,10 +2,14 @@
 #include <allegro5/allegro_image.h>
 #include <allegro5/allegro_primitives.h>
 #include <allegro5/allegro_ttf.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "./game.h"
 #include "./menu.h"
+#include "./profile.h"
 #include "./resources.h"
+#include "./spring.h"
 #include "./utils.h"
 
 #define NAME "Carcassonne"
@@ -14,6 +18,17 @@
 #define DISPLAY_W 960
 #define DISPLAY_H 540
 #define FPS 60
+/** Gdy przez IDLE_AFTER sekund nic się nie zmienia, zegar zwalnia do IDLE_FPS */
+#define IDLE_FPS 10
+#define IDLE_AFTER 2.0
+
+/**
+ * Gra i animacje są symulowane stałymi krokami SIM_DT, niezależnie od częstotliwości odświeżania, a klatka jest
+ * interpolowana między dwoma ostatnimi krokami. Po przestoju (np. długi ruch bota) nadrabiane jest co najwyżej
+ * SIM_MAX_STEPS kroków, a reszta czasu jest pomijana. Limit obejmuje też kroki przy zwolnionym zegarze (IDLE_FPS)
+ */
+#define SIM_DT (1.0 / 60)
+#define SIM_MAX_STEPS 8
 
 ALLEGRO_DISPLAY *display;
 ALLEGRO_TIMER *timer;
@@ -42,11 +57,20 @@ void resize()
   al_use_transform(&tr);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-  int t = time(NULL);
-  // printf("random seed: %d\n", t);
-  srand(t);
+  // Ziarno można podać jako `--seed N`, żeby powtórzyć rozgrywkę, `--replay PLIK` zapisuje rozegrane gry,
+  // a `--turbo` domyślnie włącza tryb turbo
+  GameConfig cfg = {.seed = time(NULL)};
+  for (int i = 1; i < argc; i++)
+    if (!strcmp(argv[i], "--turbo"))
+      cfg.turbo = true;
+    else if (i + 1 == argc)
+      break;
+    else if (!strcmp(argv[i], "--seed"))
+      cfg.seed = strtoull(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--replay"))
+      MUST_INIT((cfg.replay = fopen(argv[++i], "ab")), "replay file");
 
   // Init
   MUST_INIT(al_init(), "allegro");
@@ -84,12 +108,14 @@ int main()
   al_register_event_source(queue, al_get_keyboard_event_source());
 
   res_init();
-  menu_init();
+  menu_init(cfg);
   al_set_display_icon(display, bitmaps.icon);
 
   // Main game loop
+  // Klatka jest rysowana tylko wtedy, gdy coś się zmieniło: animacja, stan gry albo naciśnięty klawisz
   ALLEGRO_EVENT evt;
-  bool redraw = false, exit = false;
+  bool tick = false, redraw = true, idle = false, animating = false, exit = false;
+  double last_change = 0, sim_time = 0;
 
   resize();
   al_start_timer(timer);
@@ -105,54 +131,89 @@ int main()
 
     case ALLEGRO_EVENT_DISPLAY_RESIZE:
       resize();
+      redraw = true;
       break;
 
-    case ALLEGRO_EVENT_TIMER:
+    case ALLEGRO_EVENT_DISPLAY_EXPOSE:
+    case ALLEGRO_EVENT_DISPLAY_SWITCH_IN:
       redraw = true;
       break;
 
+    case ALLEGRO_EVENT_TIMER:
+      tick = true;
+      break;
+
     case ALLEGRO_EVENT_KEY_DOWN:
+      redraw = true;
+      if (PROFILE_KEYDOWN(evt.keyboard.keycode))
+        break;
       if (menu_keydown(evt.keyboard.keycode))
         exit = true;
       game_keydown(evt.keyboard.keycode);
       break;
     }
 
-    if (redraw && al_is_event_queue_empty(queue))
+    if ((tick || redraw) && al_is_event_queue_empty(queue))
     {
-      al_clear_to_color(al_map_rgb(0, 0, 0));
-      game_render(display_size.w, display_size.h);
-      menu_render(display_size.w, display_size.h);
-      al_flip_display();
-
       static double prev_time = 0;
       double current_time = al_get_time();
+      PROFILE_FRAME_START();
 
-      if (prev_time)
+      if (tick)
       {
-        float dt = current_time - prev_time;
-        game_tick(dt);
-        menu_tick(dt);
+        if (prev_time)
+        {
+          double dt = current_time - prev_time;
+          sim_time += dt < SIM_MAX_STEPS * SIM_DT ? dt : SIM_MAX_STEPS * SIM_DT;
+        }
+        prev_time = current_time;
+
+        // Po przestoju wykonuje się kilka kroków naraz, ale ruchy botów w trybie turbo mieszczą się w jednym
+        // budżecie na całą klatkę
+        double deadline = current_time + TURBO_FRAME_BUDGET;
+        bool stepped = false, changed = false;
+        for (; sim_time >= SIM_DT; sim_time -= SIM_DT, stepped = true)
+        {
+          PROFILE(ProfileGameTick) changed |= game_tick(SIM_DT, deadline);
+          PROFILE(ProfileMenuTick) changed |= menu_tick(SIM_DT);
+        }
+
+        // Animacja trwa, jeżeli zmienił coś którykolwiek krok tej klatki. Bez kroków zostaje poprzednia wartość
+        if (stepped)
+          animating = changed;
+        redraw |= changed;
+
+        // Trwająca animacja wymaga nowej klatki także wtedy, gdy od ostatniego kroku minęła tylko część kroku
+        redraw |= animating || PROFILE_VISIBLE();
+        spring_interpolate(sim_time / SIM_DT);
       }
 
-      prev_time = current_time;
-
-      /*static int fps = 0;
-      static double prev_fps_time = 0;
+      if (redraw)
+      {
+        al_clear_to_color(al_map_rgb(0, 0, 0));
+        PROFILE(ProfileGameRender) game_render(display_size.w, display_size.h);
+        PROFILE(ProfileMenuRender) menu_render(display_size.w, display_size.h);
+        PROFILE_OVERLAY(display_size.w, display_size.h);
+        PROFILE(ProfileFlip) al_flip_display();
+        last_change = current_time;
+      }
+      PROFILE_FRAME_END(redraw);
 
-      fps++;
-      if (current_time - prev_fps_time > 1)
+      // Zmiana od razu przywraca pełną liczbę klatek, żeby animacja nie zaczynała się z opóźnieniem
+      if (idle != (current_time - last_change > IDLE_AFTER))
       {
-        printf("FPS: %.2f\n", fps / (current_time - prev_fps_time));
-        fps = 0;
-        prev_fps_time = current_time;
-      }*/
+        idle = !idle;
+        al_stop_timer(timer);
+        al_set_timer_speed(timer, 1.0 / (idle ? IDLE_FPS : FPS));
+        al_start_timer(timer);
+      }
 
-      redraw = false;
+      tick = redraw = false;
     }
   }
 
   menu_deinit();
+  PROFILE_DEINIT();
   al_destroy_timer(timer);
   al_destroy_event_queue(queue);
   al_destroy_display(display);
@@ -165,5 +226,8 @@ int main()
   al_uninstall_keyboard();
   al_uninstall_system();
 
+  if (cfg.replay)
+    fclose(cfg.replay);
+
   return 0;
 }
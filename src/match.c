@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "./board.h"
+#include "./deck.h"
+#include "./match.h"
+#include "./points.h"
+
+_Thread_local Match match_own;
+_Thread_local Match *match_active;
+
+static _Thread_local match_score_cb score_cb;
+
+/**
+ * Zdobywanie punktów. Punkty dostają gracze z największą liczbą podwładnych w obiekcie,
+ * a wszyscy podwładni wracają do graczy.
+ */
+static void match_collect_points_cb(int points, TileType type, MeepleCounts meeple, CollectMeeplePos meeple_pos)
+{
+  int max = 0;
+  for (int i = 0; i <= MEEPLE_COLOR_COUNT; i++)
+    if (max < meeple[i])
+      max = meeple[i];
+
+  for (int i = 0; i < match.count; i++)
+  {
+    Player *player = &match.players[i];
+    player->meeple += meeple[player->color];
+    if (max == 0 || meeple[player->color] != max)
+      continue;
+
+    player->points += points;
+    if (score_cb)
+      score_cb(i, points, type, meeple_pos[player->color][0], meeple_pos[player->color][1]);
+  }
+}
+
+static int _cmp_players(const Player *a, const Player *b)
+{
+  return b->points - a->points;
+}
+
+void match_init(int players, int bots, uint64_t seed, match_score_cb cb)
+{
+  memset(&match, 0, sizeof(match));
+  score_cb = cb;
+  rng_seed(&match.rng, seed);
+  replay_begin(&match.replay, seed, players, bots);
+
+  deck_init();
+  board_init();
+  deck_shuffle(&match.rng);
+
+  match.count = players + bots;
+  for (int i = 0; i < match.count; i++)
+  {
+    match.players[i].color = (MeepleColor)(i + 1);
+    match.players[i].meeple = MATCH_MEEPLE;
+    match.players[i].points = 0;
+  }
+
+  for (int i = 0; i < bots; i++)
+    match.players[match.count - i - 1].bot = true;
+
+  match.turn.x = match.turn.y = BOARD_CENTER;
+  board_tile_place(deck_pop(), match.turn.x, match.turn.y);
+
+  match.index = -1;
+}
+
+static void match_turn_next()
+{
+  match.turn.active = true;
+  match.index = (match.index + 1) % match.count;
+  match.turn.tile = *deck_pop();
+  match.turn.meeple.color = match_current()->color;
+  match.turn.meeple.pos = TilePosCC;
+}
+
+bool match_turn_start()
+{
+  match_turn_next();
+  return board_tile_valid(&match.turn.tile);
+}
+
+bool match_turn_replay(ReplayTurn r)
+{
+  if (match.finished)
+    return false;
+
+  match_turn_next();
+  Turn *turn = &match.turn;
+  if (turn->tile.bitmap != REPLAY_TILE(r))
+    return false;
+
+  if (REPLAY_SKIP(r))
+    turn->skip = true;
+  else
+  {
+    turn->x = REPLAY_X(r);
+    turn->y = REPLAY_Y(r);
+    for (unsigned int i = 0; i < REPLAY_ROT(r); i++)
+      tile_rotate(&turn->tile);
+
+    if (turn->x < 1 || turn->x >= BOARD_SIZE || turn->y < 1 || turn->y >= BOARD_SIZE ||
+        !board_tile_matches(&turn->tile, turn->x, turn->y))
+      return false;
+
+    if (REPLAY_MEEPLE(r) == REPLAY_MEEPLE_NONE)
+      turn->meeple.color = MeepleNone;
+    else if (REPLAY_MEEPLE(r) > TilePosCC || match_current()->meeple == 0)
+      return false;
+    else
+      turn->meeple.pos = REPLAY_MEEPLE(r);
+  }
+
+  match_turn_end();
+  return true;
+}
+
+void match_turn_end()
+{
+  Turn *turn = &match.turn;
+  replay_turn(&match.replay, turn);
+
+  turn->active = false;
+  if (turn->skip)
+    turn->skip = false;
+  else
+  {
+    board_tile_place(&turn->tile, turn->x, turn->y);
+    if (turn->meeple.color != MeepleNone)
+    {
+      board_meeple_place(&turn->meeple, turn->x, turn->y);
+      match_current()->meeple--;
+    }
+  }
+
+  if (deck_size() == 0)
+  {
+    collect_all_points(true, match_collect_points_cb);
+    replay_finish(&match.replay, match.players);
+    match.finished = true;
+    return;
+  }
+
+  collect_points(turn->x, turn->y, false, match_collect_points_cb);
+}
+
+void match_fork(uint64_t seed)
+{
+  if (match.turn.active)
+  {
+    deck_push(1, &match.turn.tile);
+    match.index = (match.index + match.count - 1) % match.count;
+    match.turn.active = false;
+    match.turn.skip = false;
+  }
+
+  rng_seed(&match.rng, seed);
+  deck_shuffle(&match.rng);
+}
+
+void game_clone(GameState *dst)
+{
+  dst->m = match;
+  deck_save(&dst->deck);
+  board_save(&dst->board);
+}
+
+void game_state_use(GameState *s)
+{
+  match_active = s ? &s->m : NULL;
+  deck_use(s ? &s->deck : NULL);
+  board_use(s ? &s->board : NULL);
+}
+
+Player *match_current()
+{
+  return &match.players[match.index];
+}
+
+GameResults match_results()
+{
+  GameResults results = {0};
+  results.count = match.count;
+  for (int i = 0; i < match.count; i++)
+    results.players[i] = match.players[i];
+
+  qsort(&results.players, match.count, sizeof(Player), (int (*)(const void *, const void *))_cmp_players);
+  return results;
+}
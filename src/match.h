@@ -0,0 +1,86 @@
+#ifndef __match_inc
+#define __match_inc
+
+#include "./board.h"
+#include "./deck.h"
+#include "./game.h"
+#include "./replay.h"
+#include "./rng.h"
+
+/**
+ * Stan rozgrywki niezależny od wyświetlania i sterowania: gracze, aktywny gracz i obecny ruch.
+ * Z modułu korzysta zarówno gra w oknie (`game`), jak i gry bez okna (`sim`).
+ */
+typedef struct Match
+{
+  Player players[MEEPLE_COLOR_COUNT];
+  int count, index;
+  Turn turn;
+  /** Generator gry: tasowanie stosu i losowość botów */
+  Rng rng;
+  /** Zapis wszystkich dotychczasowych ruchów */
+  ReplayGame replay;
+  /** Wszystkie płytki zostały wyłożone, a punkty końcowe policzone */
+  bool finished;
+} Match;
+
+/** Liczba podwładnych każdego gracza na początku gry */
+#define MATCH_MEEPLE 7
+
+/** Rozgrywka, na której działają funkcje modułu (zob. `game_state_use()`), osobna dla każdego wątku */
+extern _Thread_local Match match_own;
+extern _Thread_local Match *match_active;
+#define match (*(match_active ? match_active : &match_own))
+
+/**
+ * Pełny stan gry w jednym miejscu i bez wskaźników (ok. 27 KB). Kopia stanu to zwykłe przypisanie,
+ * a kopie mogą być używane niezależnie w różnych wątkach, np. do przeszukiwania lub analizy ruchów.
+ */
+typedef struct GameState
+{
+  /** Nie `match`, bo tak nazywa się makro wyżej */
+  Match m;
+  Deck deck;
+  Board board;
+} GameState;
+
+/** Kopiuje stan gry, na którym działa obecny wątek */
+void game_clone(GameState *dst);
+/**
+ * Od tej chwili funkcje modułów `match`, `deck` i `board` działają w obecnym wątku na stanie `s`,
+ * bez kopiowania. NULL przywraca własny stan wątku
+ */
+void game_state_use(GameState *s);
+
+/**
+ * Funkcja wywoływana, gdy gracz zdobywa punkty. type - typ obiektu, x, y - współrzędne podwładnego gracza
+ * w danym obiekcie
+ */
+typedef void (*match_score_cb)(int player, int points, TileType type, int x, int y);
+
+/**
+ * Tworzy i tasuje stos, czyści planszę i kładzie płytkę startową. Gracze komputerowi są na końcu kolejki.
+ * Przy tym samym ziarnie i tych samych ruchach graczy rozgrywka przebiega dokładnie tak samo.
+ */
+void match_init(int players, int bots, uint64_t seed, match_score_cb cb);
+/** Przechodzi do kolejnego gracza i losuje płytkę. Zwraca false, jeżeli płytki nie da się nigdzie położyć */
+bool match_turn_start();
+/** Wykonuje ruch zapisany w `match.turn` (albo go pomija) i zbiera punkty */
+void match_turn_end();
+/**
+ * Rozgrywa cały ruch z zapisu gry, bez szukania miejsca dla płytki. Zwraca false, jeżeli ruch nie zgadza się
+ * ze stanem gry: wylosowana płytka jest inna, płytka nie pasuje w danym miejscu albo gracz nie ma podwładnych
+ */
+bool match_turn_replay(ReplayTurn r);
+
+/**
+ * Zmienia ziarno generatora i tasuje pozostałe płytki, np. żeby rozegrać wiele różnych dokończeń gry od danej
+ * pozycji. Rozpoczęty ruch jest cofany, a płytka wraca do stosu. Zapis gry przestaje pasować do ziarna.
+ */
+void match_fork(uint64_t seed);
+
+Player *match_current();
+/** Gracze posortowani malejąco według punktów */
+GameResults match_results();
+
+#endif
@@ -7,8 +7,11 @@
 #include "./board.h"
 #include "./game.h"
 #include "./menu.h"
+#include "./profile.h"
 #include "./resources.h"
+#include "./rng.h"
 #include "./spring.h"
+#include "./text.h"
 
 typedef void (*button_action)();
 
@@ -19,11 +22,12 @@ typedef struct Button
   button_action click;
   button_action left;
   button_action right;
+  TextCache label;
 } Button;
 
 typedef struct MenuPage
 {
-  Button buttons[3];
+  Button buttons[4];
   int button_count;
   int button_active;
   bool hidden;
@@ -32,7 +36,7 @@ typedef struct MenuPage
 
 #define MAKE_BUTTON(TEXT, CLICK, LEFT, RIGHT, ARROW)                                                                   \
   {                                                                                                                    \
-    TEXT, ARROW, CLICK, LEFT, RIGHT                                                                                    \
+    TEXT, ARROW, CLICK, LEFT, RIGHT, {0}                                                                               \
   }
 
 #define MAKE_PAGE(NUM, ESC, ...)                                                                                       \
@@ -52,12 +56,18 @@ static struct MenuState
   MenuPage *page;
 } menu_state;
 
+/** Plik, do którego zapisywana jest przerwana gra */
+#define SAVE_PATH "carcassonne.sav"
+
 static GameConfig cfg;
 static GameResults game_results;
+static TextCache results_text[MEEPLE_COLOR_COUNT];
+static Rng rng;
 
 // Button actions
 
 static void page_start_start();
+static void page_start_load();
 static void page_start_quit();
 
 static void page_options_esc();
@@ -65,10 +75,12 @@ static void page_options_player_add();
 static void page_options_player_sub();
 static void page_options_bot_add();
 static void page_options_bot_sub();
+static void page_options_turbo();
 static void page_options_start();
 
 static void page_pause_esc();
 static void page_pause_resume();
+static void page_pause_save();
 static void page_pause_quit();
 
 static void page_results_close();
@@ -79,28 +91,31 @@ static void game_on_finish();
 
 static MenuPage start_page = MAKE_PAGE(
 
-    2, NULL,
+    3, NULL,
 
     MAKE_BUTTON("Start game", page_start_start, NULL, NULL, false),
+    MAKE_BUTTON("Load game", page_start_load, NULL, NULL, false),
     MAKE_BUTTON("Quit game", page_start_quit, NULL, NULL, false),
 
 );
 
 static MenuPage options_page = MAKE_PAGE(
 
-    3, page_options_esc,
+    4, page_options_esc,
 
     MAKE_BUTTON("", NULL, page_options_player_sub, page_options_player_add, true),
     MAKE_BUTTON("", NULL, page_options_bot_sub, page_options_bot_add, true),
+    MAKE_BUTTON("", NULL, page_options_turbo, page_options_turbo, true),
     MAKE_BUTTON("Start", page_options_start, NULL, NULL, false),
 
 );
 
 static MenuPage game_page = MAKE_PAGE(
 
-    2, page_pause_esc,
+    3, page_pause_esc,
 
     MAKE_BUTTON("Resume game", page_pause_resume, NULL, NULL, false),
+    MAKE_BUTTON("Save game", page_pause_save, NULL, NULL, false),
     MAKE_BUTTON("Quit game", page_pause_quit, NULL, NULL, false),
 
 );
@@ -125,6 +140,7 @@ static void players_buttons_update()
 {
   sprintf(options_page.buttons[0].text, "Players: %d", cfg.players);
   sprintf(options_page.buttons[1].text, "Bots: %d", cfg.bots);
+  sprintf(options_page.buttons[2].text, "Turbo: %s", cfg.turbo ? "on" : "off");
 }
 
 // Start page actions
@@ -134,6 +150,19 @@ static void page_start_start()
   page_open(&options_page);
 }
 
+static void page_start_load()
+{
+  FILE *f = fopen(SAVE_PATH, "rb");
+  if (!f)
+    return;
+
+  page_open(&game_page);
+  game_page.hidden = true;
+  if (!game_load(cfg, f))
+    page_open(&start_page);
+  fclose(f);
+}
+
 static void page_start_quit()
 {
   menu_state.exit = true;
@@ -182,10 +211,17 @@ static void page_options_bot_sub()
   players_buttons_update();
 }
 
+static void page_options_turbo()
+{
+  cfg.turbo = !cfg.turbo;
+  players_buttons_update();
+}
+
 static void page_options_start()
 {
   page_open(&game_page);
   game_page.hidden = true;
+  cfg.seed = rng_next(&rng);
   game_init(cfg);
 }
 
@@ -194,6 +230,7 @@ static void page_options_start()
 static void page_pause_esc()
 {
   game_page.hidden = !game_page.hidden;
+  sprintf(game_page.buttons[1].text, "Save game");
   game_pause(!game_page.hidden);
 }
 
@@ -203,6 +240,23 @@ static void page_pause_resume()
   game_pause(false);
 }
 
+static void page_pause_save()
+{
+  FILE *f = fopen(SAVE_PATH, "wb");
+  bool saved = f && game_save(f);
+  // Przy pełnym dysku błąd może wyjść dopiero przy zapisie bufora w `fclose()`
+  if (f && fclose(f))
+    saved = false;
+
+  // Po błędzie menu zostaje otwarte, a przycisk pokazuje, że gra nie została zapisana
+  if (!saved)
+  {
+    sprintf(game_page.buttons[1].text, "Save failed");
+    return;
+  }
+  page_pause_resume();
+}
+
 static void page_pause_quit()
 {
   game_deinit();
@@ -229,15 +283,15 @@ static void game_on_finish(GameResults results)
 
 // Init and deinit
 
-void menu_init()
+void menu_init(GameConfig defaults)
 {
   menu_state.page = &start_page;
+  rng_seed(&rng, defaults.seed);
 
-  cfg = (GameConfig){
-      .players = 2,
-      .bots = 0,
-      .on_finish = game_on_finish,
-  };
+  cfg = defaults;
+  cfg.players = 2;
+  cfg.bots = 0;
+  cfg.on_finish = game_on_finish;
 
   players_buttons_update();
   view_init();
@@ -245,6 +299,13 @@ void menu_init()
 
 void menu_deinit()
 {
+  MenuPage *pages[] = {&start_page, &options_page, &game_page, &results_page};
+  for (size_t i = 0; i < sizeof(pages) / sizeof(pages[0]); i++)
+    for (int j = 0; j < pages[i]->button_count; j++)
+      text_free(&pages[i]->buttons[j].label);
+  for (int i = 0; i < MEEPLE_COLOR_COUNT; i++)
+    text_free(&results_text[i]);
+
   game_deinit();
 }
 
@@ -300,12 +361,12 @@ bool menu_keydown(int code)
 
 static float bg_idle = 5;
 
-void menu_tick(float dt)
+bool menu_tick(float dt)
 {
   if (menu_state.page == &game_page && !menu_state.page->hidden)
-    return;
+    return false;
 
-  view_tick(dt);
+  bool moved = view_tick(dt);
 
   if (menu_state.page == &start_page)
     bg_idle += dt;
@@ -315,18 +376,24 @@ void menu_tick(float dt)
   if (bg_idle > 5)
   {
     bg_idle = 0;
-    view_set(-BOARD_CENTER + rand() % 16 - 8, -BOARD_CENTER + rand() % 16 - 8);
+    view_set(-BOARD_CENTER + (int)rng_below(&rng, 16) - 8, -BOARD_CENTER + (int)rng_below(&rng, 16) - 8);
   }
+
+  return moved;
 }
 
 void button_render(Button *b, float x, float y, float s, bool active)
 {
   ALLEGRO_BITMAP *bitmap = b->arrowed ? bitmaps.button_arrow : bitmaps.button;
   al_draw_scaled_bitmap(bitmap, 0, 0, 3 * BMP_UI_S, BMP_UI_S, x - s * 1.5, y - s * 0.5, s * 3, s, 0);
-  al_draw_text(fonts.ui, al_map_rgb_f(1, 1, 1), x, y - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER, b->text);
+  PROFILE_DRAW(1);
+  text_draw(&b->label, x, y - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER, b->text);
 
   if (active)
+  {
     al_draw_scaled_bitmap(bitmaps.button_a, 0, 0, 3 * BMP_UI_S, BMP_UI_S, x - s * 1.5, y - s * 0.5, s * 3, s, 0);
+    PROFILE_DRAW(1);
+  }
 }
 
 void menu_results_render(float x, float y, float s)
@@ -335,9 +402,11 @@ void menu_results_render(float x, float y, float s)
   {
     float ry = y - game_results.count * s / 2 + i * s;
     al_draw_scaled_bitmap(bitmaps.result_bg[i], 0, 0, 3 * BMP_UI_S, BMP_UI_S, x - s * 1.5, ry - s * 0.5, s * 3, s, 0);
+    PROFILE_DRAW(1);
     al_draw_scaled_bitmap(bitmaps.result_meeple[game_results.players[i].color - 1], 0, 0, BMP_UI_S, BMP_UI_S, x - s,
                           ry - s * 0.5, s, s, 0);
-    al_draw_textf(fonts.ui, al_map_rgb_f(1, 1, 1), x + s * 0.5, ry - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER, "%d",
+    PROFILE_DRAW(1);
+    text_draw_int(&results_text[i], x + s * 0.5, ry - FONT_SIZE * 0.55, ALLEGRO_ALIGN_CENTER,
                   game_results.players[i].points);
   }
 }
@@ -364,6 +433,7 @@ void menu_render(float w, float h)
   {
     y += s;
     al_draw_scaled_bitmap(bitmaps.splash, 0, 0, 1024, 235, x - 4 * s, y - 4 * s, 8 * s, 2 * s, 0);
+    PROFILE_DRAW(1);
   }
   else if (menu_state.page == &results_page)
   {
@@ -1,11 +1,18 @@
 #ifndef __menu_inc
 #define __menu_inc
 
-void menu_init();
+#include "./game.h"
+
+/**
+ * Początkowe ustawienia gier. `defaults.seed` jest ziarnem, z którego wyliczane są ziarna kolejnych gier
+ * i animacja tła, a liczba graczy i `on_finish` są ustawiane przez menu
+ */
+void menu_init(GameConfig defaults);
 void menu_deinit();
 
 bool menu_keydown(int code);
-void menu_tick(float dt);
+/** Zwraca true, jeżeli trzeba narysować nową klatkę */
+bool menu_tick(float dt);
 void menu_render(float w, float h);
 
 #endif
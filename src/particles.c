@@ -0,0 +1,107 @@
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+
+#include "./particles.h"
+#include "./profile.h"
+#include "./resources.h"
+#include "./spring.h"
+
+/** Konfiguracja sprężyny postępu (tłumienie, czas ruchu) */
+#define PARTICLE_RATIO 1.5
+#define PARTICLE_DURATION 1
+
+void particles_emit(Particles *p, float x0, float y0, float s0, float x1, float y1, float s1)
+{
+  int i = p->count;
+  if (p->count < PARTICLES_CAPACITY)
+    p->count++;
+  else
+    for (int j = i = 0; j < p->count; j++)
+      if (p->t[j] > p->t[i])
+        i = j;
+
+  p->t[i] = p->v[i] = p->prev[i] = 0;
+  p->x0[i] = x0;
+  p->y0[i] = y0;
+  p->s0[i] = s0;
+  p->x1[i] = x1;
+  p->y1[i] = y1;
+  p->s1[i] = s1;
+}
+
+/** Przenosi monetę z miejsca `j` na miejsce `i` */
+static void particles_move(Particles *p, int i, int j)
+{
+  p->t[i] = p->t[j];
+  p->v[i] = p->v[j];
+  p->prev[i] = p->prev[j];
+  p->x0[i] = p->x0[j];
+  p->y0[i] = p->y0[j];
+  p->s0[i] = p->s0[j];
+  p->x1[i] = p->x1[j];
+  p->y1[i] = p->y1[j];
+  p->s1[i] = p->s1[j];
+}
+
+bool particles_update(Particles *p, float dt)
+{
+  if (!p->count)
+    return false;
+
+  if (p->dt != dt)
+  {
+    p->dt = dt;
+    spring_transition(PARTICLE_RATIO, PARTICLE_DURATION, dt, p->m);
+  }
+
+  const float m00 = p->m[0], m01 = p->m[1], m10 = p->m[2], m11 = p->m[3];
+  for (int i = 0; i < p->count; i++)
+  {
+    float y = p->t[i] - 1, v = p->v[i];
+    p->prev[i] = p->t[i];
+    p->t[i] = 1 + m00 * y + m01 * v;
+    p->v[i] = m10 * y + m11 * v;
+  }
+
+  // Moneta u celu jest już niewidoczna (przezroczystość rośnie z postępem), więc po prostu znika
+  for (int i = p->count - 1; i >= 0; i--)
+    if (p->t[i] > 1 - SPRING_EPS && p->v[i] < SPRING_EPS && p->v[i] > -SPRING_EPS)
+      particles_move(p, i, --p->count);
+
+  return true;
+}
+
+void particles_render(const Particles *p, float w, float h)
+{
+  static ALLEGRO_VERTEX v[PARTICLES_CAPACITY * 6];
+  static const int ORDER[6] = {0, 1, 2, 0, 2, 3};
+  static const float CORNERS[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+  if (!p->count)
+    return;
+
+  ALLEGRO_VERTEX *end = v;
+  for (int i = 0; i < p->count; i++)
+  {
+    float t = spring_lerp(p->prev[i], p->t[i]);
+    float x = (p->x0[i] + w / 2) * (1 - t) + p->x1[i] * t;
+    float y = (p->y0[i] + h / 2) * (1 - t) + p->y1[i] * t;
+    float s = p->s0[i] * (1 - t) + p->s1[i] * t;
+    ALLEGRO_COLOR tint = al_map_rgba_f(1 - t, 1 - t, 1 - t, 1 - t);
+
+    for (int k = 0; k < 6; k++)
+    {
+      const float *c = CORNERS[ORDER[k]];
+      *end++ = (ALLEGRO_VERTEX){.x = x + c[0] * s,
+                                .y = y + c[1] * s,
+                                .z = 0,
+                                .u = BMP_MEEPLE_S * (12 + c[0]),
+                                .v = BMP_MEEPLE_S * c[1],
+                                .color = tint};
+    }
+  }
+
+  // Rozmiar monety zmienia się w locie, więc wszystkie są rysowane z pełnej rozdzielczości atlasu
+  al_draw_prim(v, NULL, bitmaps.atlas[0], 0, end - v, ALLEGRO_PRIM_TRIANGLE_LIST);
+  PROFILE_DRAW(1);
+}
@@ -0,0 +1,37 @@
+#ifndef __particles_inc
+#define __particles_inc
+
+#include <stdbool.h>
+
+/** Pojemność puli, można ją zmienić flagą, np. -DPARTICLES_CAPACITY=1024 */
+#ifndef PARTICLES_CAPACITY
+#define PARTICLES_CAPACITY 256
+#endif
+
+/**
+ * Monety lecące od zdobytego obiektu do punktów gracza, jako struktura tablic. Żywe monety zajmują początek tablic
+ * (`0..count-1`), więc krok i rysowanie to jedna pętla po ciągłych tablicach, a wszystkie monety są rysowane jednym
+ * `al_draw_prim()`. Postęp lotu `t` (0 - start, 1 - cel) to sprężyna o tej samej konfiguracji dla wszystkich monet,
+ * liczona wspólną macierzą przejścia (zob. `spring_transition()`)
+ */
+typedef struct Particles
+{
+  int count;
+  /** Krok, dla którego policzono macierz przejścia `m` */
+  float dt;
+  float m[4];
+  /** Postęp, jego prędkość i postęp przed ostatnim krokiem (do interpolacji przy rysowaniu) */
+  float t[PARTICLES_CAPACITY], v[PARTICLES_CAPACITY], prev[PARTICLES_CAPACITY];
+  /** Start względem środka ekranu (jak plansza) i cel względem lewego górnego rogu (jak panel graczy), z rozmiarem */
+  float x0[PARTICLES_CAPACITY], y0[PARTICLES_CAPACITY], s0[PARTICLES_CAPACITY];
+  float x1[PARTICLES_CAPACITY], y1[PARTICLES_CAPACITY], s1[PARTICLES_CAPACITY];
+} Particles;
+
+/** Dodaje monetę. Przy pełnej puli zastępuje monetę najbliższą celu, która i tak zaraz by znikła */
+void particles_emit(Particles *p, float x0, float y0, float s0, float x1, float y1, float s1);
+/** Krok wszystkich monet. Zwraca false, jeżeli nie było żadnej */
+bool particles_update(Particles *p, float dt);
+/** Rysuje wszystkie monety na ekranie o rozmiarach `w` na `h` */
+void particles_render(const Particles *p, float w, float h);
+
+#endif
@@ -4,8 +4,8 @@
 #include "./points.h"
 #include "./utils.h"
 
-static int tile_vis[BOARD_SIZE][BOARD_SIZE] = {0};
-static int city_vis[BOARD_SIZE][BOARD_SIZE] = {0};
+static _Thread_local int tile_vis[BOARD_SIZE][BOARD_SIZE] = {0};
+static _Thread_local int city_vis[BOARD_SIZE][BOARD_SIZE] = {0};
 
 #define TILE_ID(X, Y, POS) board_tile_get(x, y)->ids[POS]
 
@@ -152,7 +152,7 @@ static void collect_points_feature(int x, int y, TilePos pos, bool finish, colle
     MeepleCounts meeple;
     CollectMeeplePos meeple_pos;
     board_collect_meeple(x, y, pos, true, meeple, meeple_pos);
-    cb(points, meeple, meeple_pos);
+    cb(points, t->types[pos], meeple, meeple_pos);
   }
 }
 
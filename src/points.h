@@ -3,7 +3,8 @@
 
 #include "./board.h"
 
-typedef void (*collect_points_cb)(int points, MeepleCounts meeple, CollectMeeplePos pos);
+/** Funkcja wywoływana dla każdego obiektu, który daje punkty. type - typ obiektu (droga/miasto/...) */
+typedef void (*collect_points_cb)(int points, TileType type, MeepleCounts meeple, CollectMeeplePos pos);
 void collect_points(int x, int y, bool finish, collect_points_cb cb);
 void collect_all_points(bool finish, collect_points_cb cb);
 
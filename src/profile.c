@@ -0,0 +1,138 @@
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_primitives.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./profile.h"
+
+/** Czas pracy (od zdarzenia do `al_flip_display()`) ostatnich narysowanych klatek, z niego liczone są percentyle */
+#define PROFILE_FRAMES 256
+#define PROFILE_LINES (ProfilePhaseCount + 2)
+
+static const char *PHASE_NAMES[ProfilePhaseCount] = {"game_tick", "menu_tick", "game_render", "menu_render", "flip"};
+
+int profile_draws;
+
+static struct Profile
+{
+  bool visible;
+  double frame_start, period_start;
+
+  // Bieżący okres (1 s)
+  double phases[ProfilePhaseCount];
+  int calls[ProfilePhaseCount];
+  int frames, draws;
+  float frame_ms[PROFILE_FRAMES];
+  int frame_count, frame_idx;
+
+  /** Podsumowanie poprzedniego okresu, pokazywane na ekranie */
+  char lines[PROFILE_LINES][96];
+  ALLEGRO_FONT *font;
+} profile;
+
+void profile_add(ProfilePhase phase, double seconds)
+{
+  profile.phases[phase] += seconds;
+  profile.calls[phase]++;
+}
+
+void profile_frame_start()
+{
+  profile.frame_start = al_get_time();
+  profile_draws = 0;
+}
+
+static int _cmp_float(const float *a, const float *b)
+{
+  return *a < *b ? -1 : *a > *b;
+}
+
+static void profile_summary(double now)
+{
+  double period = now - profile.period_start;
+  int frames = profile.frames ? profile.frames : 1;
+
+  static float sorted[PROFILE_FRAMES];
+  int n = profile.frame_count;
+  memcpy(sorted, profile.frame_ms, n * sizeof(float));
+  qsort(sorted, n, sizeof(float), (int (*)(const void *, const void *))_cmp_float);
+#define P(Q) (n ? sorted[(int)((Q) * (n - 1))] : 0)
+
+  snprintf(profile.lines[0], sizeof(profile.lines[0]), "fps %.1f  frame ms p50 %.2f p95 %.2f p99 %.2f max %.2f",
+           profile.frames / period, P(0.5), P(0.95), P(0.99), P(1));
+  snprintf(profile.lines[1], sizeof(profile.lines[1]), "draws/frame %.1f", (double)profile.draws / frames);
+  // Średni czas jednego wywołania fazy - tiki wykonują się także w klatkach, które nie są rysowane
+  double phase_ms[ProfilePhaseCount];
+  for (int i = 0; i < ProfilePhaseCount; i++)
+  {
+    phase_ms[i] = profile.calls[i] ? profile.phases[i] * 1e3 / profile.calls[i] : 0;
+    snprintf(profile.lines[i + 2], sizeof(profile.lines[i + 2]), "%-12s %.3f ms", PHASE_NAMES[i], phase_ms[i]);
+  }
+#undef P
+
+  fprintf(stderr, "profile: %s, %s", profile.lines[0], profile.lines[1]);
+  for (int i = 0; i < ProfilePhaseCount; i++)
+    fprintf(stderr, ", %s %.3f", PHASE_NAMES[i], phase_ms[i]);
+  fprintf(stderr, "\n");
+
+  memset(profile.phases, 0, sizeof(profile.phases));
+  memset(profile.calls, 0, sizeof(profile.calls));
+  profile.frames = profile.draws = 0;
+  profile.period_start = now;
+}
+
+void profile_frame_end(bool rendered)
+{
+  double now = al_get_time();
+
+  if (rendered)
+  {
+    profile.frame_ms[profile.frame_idx] = (now - profile.frame_start) * 1e3;
+    profile.frame_idx = (profile.frame_idx + 1) % PROFILE_FRAMES;
+    profile.frame_count += profile.frame_count < PROFILE_FRAMES;
+    profile.frames++;
+    profile.draws += profile_draws;
+  }
+
+  if (!profile.period_start)
+    profile.period_start = now;
+  else if (now - profile.period_start >= 1)
+    profile_summary(now);
+}
+
+void profile_overlay(float w, float h)
+{
+  if (!profile.visible)
+    return;
+  if (!profile.font)
+    profile.font = al_create_builtin_font();
+
+  float lh = al_get_font_line_height(profile.font) + 2;
+  float y = h - PROFILE_LINES * lh - 8;
+  al_draw_filled_rectangle(0, y - 4, w / 2, h, al_map_rgba(0, 0, 0, 160));
+  for (int i = 0; i < PROFILE_LINES; i++)
+    al_draw_text(profile.font, al_map_rgb(255, 255, 255), 8, y + i * lh, ALLEGRO_ALIGN_LEFT, profile.lines[i]);
+}
+
+bool profile_visible()
+{
+  return profile.visible;
+}
+
+void profile_deinit()
+{
+  if (profile.font)
+    al_destroy_font(profile.font);
+  profile.font = NULL;
+}
+
+bool profile_keydown(int code)
+{
+  if (code != ALLEGRO_KEY_F3)
+    return false;
+
+  profile.visible = !profile.visible;
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef __profile_inc
+#define __profile_inc
+
+#include <stdbool.h>
+
+/**
+ * Profiler klatek (tylko z flagą -DFRAME_PROFILE, `make profile`). Mierzy czas faz pętli głównej i liczbę
+ * wywołań rysujących, co sekundę wypisuje podsumowanie na stderr, a klawisz F3 pokazuje je na ekranie.
+ * Bez flagi wszystkie makra znikają, a funkcje modułu nie są wywoływane
+ */
+typedef enum ProfilePhase
+{
+  ProfileGameTick,
+  ProfileMenuTick,
+  ProfileGameRender,
+  ProfileMenuRender,
+  ProfileFlip,
+  ProfilePhaseCount,
+} ProfilePhase;
+
+void profile_add(ProfilePhase phase, double seconds);
+void profile_frame_start();
+/** Koniec obrotu pętli głównej. `rendered` - czy klatka była rysowana */
+void profile_frame_end(bool rendered);
+void profile_overlay(float w, float h);
+/** Czy podsumowanie jest na ekranie. Wtedy każda klatka jest rysowana */
+bool profile_visible();
+void profile_deinit();
+bool profile_keydown(int code);
+
+extern int profile_draws;
+
+#ifdef FRAME_PROFILE
+#include <allegro5/allegro.h>
+
+/** Mierzy czas instrukcji lub bloku po makrze, np. `PROFILE(ProfileFlip) al_flip_display();` */
+#define PROFILE(P)                                                                                                     \
+  for (double _profile_t = al_get_time(), _profile_once = 1; _profile_once;                                            \
+       _profile_once = 0, profile_add(P, al_get_time() - _profile_t))
+#define PROFILE_DRAW(N) (profile_draws += (N))
+#define PROFILE_FRAME_START() profile_frame_start()
+#define PROFILE_FRAME_END(R) profile_frame_end(R)
+#define PROFILE_OVERLAY(W, H) profile_overlay(W, H)
+#define PROFILE_KEYDOWN(C) profile_keydown(C)
+#define PROFILE_VISIBLE() profile_visible()
+#define PROFILE_DEINIT() profile_deinit()
+#else
+#define PROFILE(P)
+#define PROFILE_DRAW(N)
+#define PROFILE_FRAME_START()
+#define PROFILE_FRAME_END(R)
+#define PROFILE_OVERLAY(W, H)
+#define PROFILE_KEYDOWN(C) false
+#define PROFILE_VISIBLE() false
+#define PROFILE_DEINIT()
+#endif
+
+#endif
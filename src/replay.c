@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "./replay.h"
+
+void replay_begin(ReplayGame *game, uint64_t seed, int players, int bots)
+{
+  memset(game, 0, sizeof(ReplayGame));
+  game->seed = seed;
+  game->players = players + bots;
+  for (int i = 0; i < bots; i++)
+    game->bots |= 1 << (game->players - i - 1);
+}
+
+void replay_turn(ReplayGame *game, const Turn *turn)
+{
+  if (game->turn_count >= TILE_COUNT)
+    return;
+
+  ReplayTurn r = turn->tile.bitmap & 0x1f;
+  if (turn->skip)
+    r |= (ReplayTurn)REPLAY_MEEPLE_NONE << 23 | 1u << 27;
+  else
+  {
+    uint32_t meeple = turn->meeple.color == MeepleNone ? REPLAY_MEEPLE_NONE : turn->meeple.pos;
+    r |= (ReplayTurn)turn->x << 5 | (ReplayTurn)turn->y << 13 | (ReplayTurn)(turn->tile.rot & 3) << 21 | meeple << 23;
+  }
+
+  game->turns[game->turn_count++] = r;
+}
+
+void replay_finish(ReplayGame *game, const Player *players)
+{
+  for (int i = 0; i < game->players; i++)
+    game->points[i] = players[i].points;
+}
+
+// Encoding
+
+#define PUT_U16(P, V) ((P)[0] = (V), (P)[1] = (V) >> 8)
+#define PUT_U32(P, V) (PUT_U16(P, V), PUT_U16((P) + 2, (V) >> 16))
+#define PUT_U64(P, V) (PUT_U32(P, V), PUT_U32((P) + 4, (V) >> 32))
+
+#define GET_U16(P) (uint16_t)((P)[0] | (P)[1] << 8)
+#define GET_U32(P) ((uint32_t)GET_U16(P) | (uint32_t)GET_U16((P) + 2) << 16)
+#define GET_U64(P) ((uint64_t)GET_U32(P) | (uint64_t)GET_U32((P) + 4) << 32)
+
+size_t replay_size(const ReplayGame *game)
+{
+  return REPLAY_HEADER_SIZE + REPLAY_TURN_SIZE * game->turn_count + REPLAY_FOOTER_SIZE;
+}
+
+size_t replay_encode(const ReplayGame *game, uint8_t *buf)
+{
+  uint8_t *p = buf;
+
+  memcpy(p, REPLAY_MAGIC, 4);
+  p[4] = REPLAY_VERSION;
+  p[5] = game->players;
+  p[6] = game->bots;
+  p[7] = game->turn_count;
+  PUT_U64(p + 8, game->seed);
+  p += REPLAY_HEADER_SIZE;
+
+  for (int i = 0; i < game->turn_count; i++, p += REPLAY_TURN_SIZE)
+    PUT_U32(p, game->turns[i]);
+
+  for (int i = 0; i < MEEPLE_COLOR_COUNT; i++, p += 2)
+    PUT_U16(p, game->points[i]);
+
+  return p - buf;
+}
+
+size_t replay_decode(const uint8_t *buf, size_t size, ReplayGame *game)
+{
+  if (size < REPLAY_HEADER_SIZE || memcmp(buf, REPLAY_MAGIC, 4) || buf[4] != REPLAY_VERSION)
+    return 0;
+
+  const uint8_t *p = buf;
+  memset(game, 0, sizeof(ReplayGame));
+  game->players = p[5];
+  game->bots = p[6];
+  game->turn_count = p[7];
+  game->seed = GET_U64(p + 8);
+  p += REPLAY_HEADER_SIZE;
+
+  if (game->players < 1 || game->players > MEEPLE_COLOR_COUNT || game->turn_count > TILE_COUNT ||
+      size < replay_size(game))
+    return 0;
+
+  for (int i = 0; i < game->turn_count; i++, p += REPLAY_TURN_SIZE)
+    game->turns[i] = GET_U32(p);
+
+  for (int i = 0; i < MEEPLE_COLOR_COUNT; i++, p += 2)
+    game->points[i] = GET_U16(p);
+
+  return p - buf;
+}
+
+bool replay_save(const ReplayGame *game, FILE *f)
+{
+  uint8_t buf[REPLAY_MAX_SIZE];
+  size_t size = replay_encode(game, buf);
+  return fwrite(buf, 1, size, f) == size;
+}
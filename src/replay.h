@@ -0,0 +1,64 @@
+#ifndef __replay_inc
+#define __replay_inc
+
+#include <stdio.h>
+
+#include "./game.h"
+
+/**
+ * Zapis rozegranej gry
+ * Stos jest wyznaczony przez ziarno, więc wystarczy zapisać ruchy graczy. Gra zajmuje w pliku:
+ *
+ * - nagłówek (16 bajtów): "CRPL", wersja, liczba graczy, maska graczy komputerowych, liczba ruchów, ziarno (u64)
+ * - ruchy (po 4 bajty): bity 0-4 - bitmapa płytki, 5-12 - x, 13-20 - y, 21-22 - obrót, 23-26 - pozycja
+ *   podwładnego (15 - brak), 27 - ruch pominięty
+ * - zakończenie (10 bajtów): punkty graczy (u16) według miejsca przy stole
+ *
+ * Wszystkie liczby są zapisane w kolejności little-endian. Plik z wieloma grami to po prostu kolejne gry.
+ */
+#define REPLAY_MAGIC "CRPL"
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 16
+#define REPLAY_TURN_SIZE 4
+#define REPLAY_FOOTER_SIZE (2 * MEEPLE_COLOR_COUNT)
+#define REPLAY_MAX_SIZE (REPLAY_HEADER_SIZE + REPLAY_TURN_SIZE * TILE_COUNT + REPLAY_FOOTER_SIZE)
+
+typedef uint32_t ReplayTurn;
+
+#define REPLAY_MEEPLE_NONE 15
+
+#define REPLAY_TILE(R) ((R)&0x1f)
+#define REPLAY_X(R) (((R) >> 5) & 0xff)
+#define REPLAY_Y(R) (((R) >> 13) & 0xff)
+#define REPLAY_ROT(R) (((R) >> 21) & 0x3)
+#define REPLAY_MEEPLE(R) (((R) >> 23) & 0xf)
+#define REPLAY_SKIP(R) (((R) >> 27) & 0x1)
+
+typedef struct ReplayGame
+{
+  uint64_t seed;
+  uint8_t players;
+  /** bit i - gracz i jest komputerowy */
+  uint8_t bots;
+  uint8_t turn_count;
+  ReplayTurn turns[TILE_COUNT];
+  uint16_t points[MEEPLE_COLOR_COUNT];
+} ReplayGame;
+
+/** Rozpoczyna zapis gry. Gracze komputerowi są na końcu kolejki, tak jak w `match_init()` */
+void replay_begin(ReplayGame *game, uint64_t seed, int players, int bots);
+/** Dopisuje ruch, zanim zostanie wykonany */
+void replay_turn(ReplayGame *game, const Turn *turn);
+/** Zapisuje końcowe punkty graczy */
+void replay_finish(ReplayGame *game, const Player *players);
+
+/** Rozmiar gry w pliku */
+size_t replay_size(const ReplayGame *game);
+/** Koduje grę do bufora o rozmiarze co najmniej `replay_size()`. Zwraca liczbę zapisanych bajtów */
+size_t replay_encode(const ReplayGame *game, uint8_t *buf);
+/** Odczytuje grę z początku bufora. Zwraca liczbę odczytanych bajtów albo 0, jeżeli dane są niepoprawne */
+size_t replay_decode(const uint8_t *buf, size_t size, ReplayGame *game);
+/** Dopisuje grę na koniec pliku jednym zapisem, więc kilka wątków może zapisywać do tego samego pliku */
+bool replay_save(const ReplayGame *game, FILE *f);
+
+#endif
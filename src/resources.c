@@ -6,29 +6,57 @@
 #include "./resources.h"
 #include "./utils.h"
 
-static ALLEGRO_BITMAP *board, *ui;
+static ALLEGRO_BITMAP *ui;
 
 Bitmaps bitmaps;
 Fonts fonts;
 
+/**
+ * Poziomy atlasu są tworzone raz, przez dwukrotne pomniejszanie poprzedniego poziomu. Przy skali dokładnie 1/2
+ * filtrowanie liniowe uśrednia kwadraty 2x2 piksele, a granice płytek leżą na parzystych pikselach każdego poziomu,
+ * więc sąsiednie płytki atlasu się nie mieszają. Pomniejszona plansza próbkuje mniejszą teksturę i nie migocze
+ */
+static void res_atlas_init()
+{
+  ALLEGRO_STATE state;
+  al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+  al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+
+  for (int k = 1; k < ATLAS_LEVELS; k++)
+  {
+    ALLEGRO_BITMAP *src = bitmaps.atlas[k - 1];
+    int w = al_get_bitmap_width(src), h = al_get_bitmap_height(src);
+
+    bitmaps.atlas[k] = al_create_bitmap(w / 2, h / 2);
+    MUST_INIT(bitmaps.atlas[k], "board bitmap level");
+
+    al_set_target_bitmap(bitmaps.atlas[k]);
+    al_draw_scaled_bitmap(src, 0, 0, w, h, 0, 0, w / 2, h / 2, 0);
+  }
+
+  al_restore_state(&state);
+}
+
+int res_atlas_level(float px)
+{
+  int k = 0;
+  while (k < ATLAS_LEVELS - 1 && (BMP_TILES_S >> (k + 1)) >= px)
+    k++;
+  return k;
+}
+
 void res_init()
 {
   al_set_new_bitmap_flags(ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
 
   fonts.ui = al_load_ttf_font("./res/barbedor.ttf", FONT_SIZE, 0);
 
-  board = al_load_bitmap("./res/board.png");
-  MUST_INIT(board, "board bitmap");
+  bitmaps.atlas[0] = al_load_bitmap("./res/board.png");
+  MUST_INIT(bitmaps.atlas[0], "board bitmap");
+  res_atlas_init();
 
-  for (int i = 0; i < 5; i++)
-    bitmaps.meeple[i] = al_create_sub_bitmap(board, BMP_MEEPLE_S * (i + 6), 0, BMP_MEEPLE_S, BMP_MEEPLE_S);
-  bitmaps.coin = al_create_sub_bitmap(board, BMP_MEEPLE_S * 12, 0 * BMP_MEEPLE_S, BMP_MEEPLE_S, BMP_MEEPLE_S);
-
-  for (int i = 0; i < 24; i++)
-    bitmaps.tiles[i] =
-        al_create_sub_bitmap(board, BMP_TILES_S * (i / 8), BMP_TILES_S * (i % 8), BMP_TILES_S, BMP_TILES_S);
   bitmaps.tile_highlight =
-      al_create_sub_bitmap(board, BMP_TILES_S * 3.5, BMP_TILES_S * 1.5, 2 * BMP_TILES_S, 2 * BMP_TILES_S);
+      al_create_sub_bitmap(bitmaps.atlas[0], BMP_TILES_S * 3.5, BMP_TILES_S * 1.5, 2 * BMP_TILES_S, 2 * BMP_TILES_S);
 
   ui = al_load_bitmap("./res/ui.png");
   MUST_INIT(ui, "ui bitmap");
@@ -60,15 +88,10 @@ void res_init()
 
 void res_deinit()
 {
-  for (int i = 0; i < 24; i++)
-    al_destroy_bitmap(bitmaps.tiles[i]);
   al_destroy_bitmap(bitmaps.tile_highlight);
 
-  for (int i = 0; i < 5; i++)
-    al_destroy_bitmap(bitmaps.meeple[i]);
-  al_destroy_bitmap(bitmaps.coin);
-
-  al_destroy_bitmap(board);
+  for (int k = 0; k < ATLAS_LEVELS; k++)
+    al_destroy_bitmap(bitmaps.atlas[k]);
 
   for (int i = 0; i < 5; i++)
     al_destroy_bitmap(bitmaps.player_state[i]);
@@ -10,13 +10,18 @@
 #define BMP_UI_S 128
 #define FONT_SIZE 24
 
+/** Poziomy atlasu `board.png`: na poziomie k płytka ma BMP_TILES_S >> k pikseli (od 256 do 8) */
+#define ATLAS_LEVELS 6
+
 typedef struct Bitmaps
 {
   // Board
-  ALLEGRO_BITMAP *tiles[24];
+  /**
+   * Atlas `board.png` z płytkami, podwładnymi i monetą oraz jego pomniejszone kopie (zob. `res_atlas_level()`).
+   * Współrzędne na poziomie k to współrzędne na poziomie 0 podzielone przez 2^k
+   */
+  ALLEGRO_BITMAP *atlas[ATLAS_LEVELS];
   ALLEGRO_BITMAP *tile_highlight;
-  ALLEGRO_BITMAP *meeple[6];
-  ALLEGRO_BITMAP *coin;
 
   // Game state
   ALLEGRO_BITMAP *player_state[5];
@@ -49,4 +54,7 @@ extern Fonts fonts;
 void res_init();
 void res_deinit();
 
+/** Najmniejszy poziom atlasu, na którym płytka ma co najmniej `px` pikseli */
+int res_atlas_level(float px);
+
 #endif
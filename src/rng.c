@@ -0,0 +1,44 @@
+#include "./rng.h"
+
+#define ROTL(X, K) (((X) << (K)) | ((X) >> (64 - (K))))
+
+/** Rozwija ziarno na cały stan generatora (splitmix64), żeby podobne ziarna dawały niezależne ciągi */
+void rng_seed(Rng *rng, uint64_t seed)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    rng->s[i] = z ^ (z >> 31);
+  }
+}
+
+uint64_t rng_next(Rng *rng)
+{
+  uint64_t *s = rng->s;
+  uint64_t result = ROTL(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = ROTL(s[3], 45);
+
+  return result;
+}
+
+/** Metoda Lemire'a: mnożenie zamiast dzielenia, a wyniki z niepełnego ostatniego przedziału są odrzucane */
+uint32_t rng_below(Rng *rng, uint32_t n)
+{
+  uint64_t m = (rng_next(rng) >> 32) * n;
+  if ((uint32_t)m < n)
+  {
+    uint32_t threshold = -n % n;
+    while ((uint32_t)m < threshold)
+      m = (rng_next(rng) >> 32) * n;
+  }
+  return m >> 32;
+}
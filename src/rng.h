@@ -0,0 +1,21 @@
+#ifndef __rng_inc
+#define __rng_inc
+
+#include <stdint.h>
+
+/**
+ * Generator liczb pseudolosowych (xoshiro256**)
+ * Każda gra ma własny generator, więc przy tym samym ziarnie rozgrywka przebiega dokładnie tak samo,
+ * niezależnie od innych gier rozgrywanych w tym samym czasie.
+ */
+typedef struct Rng
+{
+  uint64_t s[4];
+} Rng;
+
+void rng_seed(Rng *rng, uint64_t seed);
+uint64_t rng_next(Rng *rng);
+/** Liczba z przedziału [0, n), bez przesunięcia rozkładu jak przy `rand() % n` */
+uint32_t rng_below(Rng *rng, uint32_t n);
+
+#endif
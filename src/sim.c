@@ -0,0 +1,266 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./deck.h"
+#include "./match.h"
+#include "./sim.h"
+#include "./utils.h"
+
+#define SIM_THREAD_STACK_SIZE (16 << 20)
+
+static double sim_time_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/** Statystyki gry rozgrywanej w obecnym wątku, dla `sim_score_cb` */
+static _Thread_local GameStats *sim_stats;
+
+static void sim_score_cb(int player, int points, TileType type, int x, int y)
+{
+  UNUSED2(x, y);
+  stats_score(sim_stats, player, points, type);
+}
+
+void sim_play(const SimConfig *cfg, SimResult *result)
+{
+  memset(result, 0, sizeof(SimResult));
+  sim_stats = cfg->stats;
+  match_init(0, cfg->players, cfg->seed, cfg->stats ? sim_score_cb : NULL);
+  if (cfg->start)
+  {
+    snapshot_restore(cfg->start);
+    match_fork(cfg->seed);
+  }
+
+  for (int i = 0; i < cfg->players; i++)
+    if (cfg->engines[i])
+      engine_new_game(cfg->engines[i], i);
+
+  while (!match.finished)
+  {
+    float move_ms = 0;
+    if (!match_turn_start())
+      match.turn.skip = true;
+    else
+    {
+      double start = sim_time_ms();
+
+      if (cfg->bots[match.index] == BotKindRandom)
+        bot_turn_random(match_current(), &match.turn, &match.rng);
+      else if (cfg->bots[match.index] == BotKindEngine)
+        engine_turn(cfg->engines[match.index], &match.turn, cfg->engine_ms);
+      else
+        bot_turn(match_current(), &match.turn, deck_size() / match.count, &match.rng);
+
+      move_ms = sim_time_ms() - start;
+      result->move_ms[result->move_count] = move_ms;
+      result->move_seat[result->move_count] = match.index;
+      result->move_count++;
+    }
+
+    for (int i = 0; i < cfg->players; i++)
+      if (cfg->engines[i])
+        engine_observe(cfg->engines[i], &match.turn);
+
+    if (cfg->stats)
+      stats_turn(cfg->stats, match.index, &match.turn, match_current()->meeple, move_ms);
+
+    match_turn_end();
+
+    for (int i = 0; i < cfg->players; i++)
+      if (cfg->engines[i])
+        engine_points(cfg->engines[i]);
+  }
+
+  for (int i = 0; i < match.count; i++)
+    result->points[i] = match.players[i].points;
+
+  if (cfg->stats)
+    stats_game_end(cfg->stats, match.players, match.count);
+
+  if (cfg->replay && !cfg->start)
+    replay_save(&match.replay, cfg->replay);
+}
+
+// Batch
+
+/** Zakres gier [next, end) spakowany w jedno słowo, żeby właściciel i inne wątki mogły go zmieniać atomowo */
+#define SIM_RANGE(NEXT, END) ((uint64_t)(NEXT) << 32 | (uint32_t)(END))
+
+/** Kontekst jednego wątku, przygotowany raz i używany we wszystkich jego grach */
+typedef struct SimWorker
+{
+  /** Gry do rozegrania. Na osobnej linii pamięci podręcznej, bo zmieniają ją też inne wątki */
+  _Alignas(64) _Atomic uint64_t range;
+  int index, count;
+  struct SimWorker *all;
+  pthread_t thread;
+
+  SimConfig cfg;
+  uint64_t seed;
+  SimResult *results, result;
+  /** Wyniki gier tego wątku, łączone po zakończeniu wszystkich wątków */
+  SimBatch partial;
+  GameStats stats;
+  GameState state;
+  Engine engines[MEEPLE_COLOR_COUNT];
+} SimWorker;
+
+static bool sim_pop(SimWorker *w, int *game)
+{
+  uint64_t r = atomic_load(&w->range);
+  do
+  {
+    if ((r >> 32) >= (uint32_t)r)
+      return false;
+  } while (!atomic_compare_exchange_weak(&w->range, &r, r + ((uint64_t)1 << 32)));
+
+  *game = r >> 32;
+  return true;
+}
+
+/** Zabiera drugą połowę gier pierwszego wątku, który jeszcze je ma. Zwraca false, jeżeli żaden nie ma */
+static bool sim_steal(SimWorker *w)
+{
+  for (int i = 1; i < w->count; i++)
+  {
+    SimWorker *victim = &w->all[(w->index + i) % w->count];
+    uint64_t r = atomic_load(&victim->range);
+    uint32_t next, end, mid;
+    do
+    {
+      next = r >> 32;
+      end = r;
+      if (next >= end)
+        break;
+      mid = end - (end - next + 1) / 2;
+    } while (!atomic_compare_exchange_weak(&victim->range, &r, SIM_RANGE(next, mid)));
+
+    // Własny zakres jest pusty, więc nikt inny go w tej chwili nie zmienia
+    if (next < end)
+    {
+      atomic_store(&w->range, SIM_RANGE(mid, end));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void sim_batch_add(SimBatch *b, const SimResult *r, int players)
+{
+  // Przy remisie wygrana jest dzielona między wszystkich graczy z najlepszym wynikiem
+  int best = 0, winners = 0;
+  for (int i = 0; i < players; i++)
+    if (r->points[i] > best)
+      best = r->points[i], winners = 1;
+    else if (r->points[i] == best)
+      winners++;
+
+  for (int i = 0; i < players; i++)
+  {
+    b->points[i] += r->points[i];
+    if (r->points[i] == best)
+      b->wins[i] += 1.0 / winners;
+  }
+}
+
+static void *sim_worker(void *arg)
+{
+  SimWorker *w = arg;
+  SimConfig *cfg = &w->cfg;
+  if (cfg->stats)
+    cfg->stats = &w->stats;
+
+  for (int i = 0; i < cfg->players; i++)
+    if (cfg->bots[i] == BotKindEngine)
+    {
+      ASSERTF(engine_start(&w->engines[i], cfg->engine), "Couldn't start engine '%s'.", cfg->engine);
+      cfg->engines[i] = &w->engines[i];
+    }
+
+  game_state_use(&w->state);
+
+  for (int game;;)
+  {
+    if (!sim_pop(w, &game))
+    {
+      if (!sim_steal(w))
+        break;
+      continue;
+    }
+
+    SimResult *r = w->results ? &w->results[game] : &w->result;
+    cfg->seed = w->seed + game;
+    sim_play(cfg, r);
+    sim_batch_add(&w->partial, r, cfg->players);
+  }
+
+  game_state_use(NULL);
+
+  for (int i = 0; i < cfg->players; i++)
+    if (cfg->engines[i])
+    {
+      w->partial.engine_errors[i] = w->engines[i].errors;
+      engine_stop(&w->engines[i]);
+    }
+
+  return NULL;
+}
+
+SimBatch sim_run_batch(const SimConfig *cfg, int games, int threads, uint64_t seed, SimResult *results)
+{
+  SimBatch batch = {.games = games, .threads = threads};
+
+  SimWorker *workers = aligned_alloc(_Alignof(SimWorker), threads * sizeof(SimWorker));
+  MUST_INIT(workers, "workers");
+  memset(workers, 0, threads * sizeof(SimWorker));
+
+  // Stan gry jest trzymany w zmiennych lokalnych dla wątku, więc wątki potrzebują większego stosu
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, SIM_THREAD_STACK_SIZE);
+
+  double start = sim_time_ms();
+
+  for (int i = 0; i < threads; i++)
+  {
+    SimWorker *w = &workers[i];
+    atomic_init(&w->range, SIM_RANGE((int64_t)games * i / threads, (int64_t)games * (i + 1) / threads));
+    w->index = i;
+    w->count = threads;
+    w->all = workers;
+    w->cfg = *cfg;
+    w->seed = seed;
+    w->results = results;
+  }
+
+  for (int i = 0; i < threads; i++)
+    MUST_INIT(!pthread_create(&workers[i].thread, &attr, sim_worker, &workers[i]), "thread");
+  for (int i = 0; i < threads; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  batch.wall_s = (sim_time_ms() - start) / 1e3;
+
+  for (int i = 0; i < threads; i++)
+    for (int p = 0; p < MEEPLE_COLOR_COUNT; p++)
+    {
+      batch.wins[p] += workers[i].partial.wins[p];
+      batch.points[p] += workers[i].partial.points[p];
+      batch.engine_errors[p] += workers[i].partial.engine_errors[p];
+    }
+
+  if (cfg->stats)
+    for (int i = 0; i < threads; i++)
+      stats_merge(cfg->stats, &workers[i].stats);
+
+  pthread_attr_destroy(&attr);
+  free(workers);
+  return batch;
+}
@@ -0,0 +1,68 @@
+#ifndef __sim_inc
+#define __sim_inc
+
+#include "./bot.h"
+#include "./engine.h"
+#include "./game.h"
+#include "./snapshot.h"
+#include "./stats.h"
+
+/** Ustawienia pojedynczej gry bez okna. Wszyscy gracze są botami */
+typedef struct SimConfig
+{
+  int players;
+  uint64_t seed;
+  /** Plik, do którego dopisywany jest zapis gry (może być NULL). Gry rozpoczęte z `start` nie są zapisywane */
+  FILE *replay;
+  /** Pozycja, od której zaczyna się gra (może być NULL). Pozostałe płytki są tasowane według `seed` */
+  const Snapshot *start;
+  BotKind bots[MEEPLE_COLOR_COUNT];
+  /**
+   * Silniki dla miejsc z `BotKindEngine` i limit czasu na ich ruch. `sim_run_batch()` uruchamia w każdym
+   * wątku własne silniki poleceniem `engine`, a `sim_play()` używa już uruchomionych z `engines`
+   */
+  const char *engine;
+  Engine *engines[MEEPLE_COLOR_COUNT];
+  int engine_ms;
+  /** Statystyki, do których dodawane są rozegrane gry (może być NULL). `sim_run_batch()` łączy je z wątków */
+  GameStats *stats;
+} SimConfig;
+
+/**
+ * Wynik gry bez okna
+ * points - punkty według miejsca przy stole (a nie według kolejności w rankingu)
+ * move_ms, move_seat - czas namysłu bota (u silników razem z komunikacją) i miejsce gracza w kolejnych ruchach
+ */
+typedef struct SimResult
+{
+  int points[MEEPLE_COLOR_COUNT];
+  int move_count;
+  float move_ms[TILE_COUNT];
+  uint8_t move_seat[TILE_COUNT];
+} SimResult;
+
+/**
+ * Zbiorcze wyniki wielu gier, według miejsca przy stole
+ * wins - wygrane (remis dzieli wygraną między najlepszych graczy), points - suma punktów,
+ * engine_errors - spóźnione lub niepoprawne ruchy silników
+ */
+typedef struct SimBatch
+{
+  int games, threads;
+  double wall_s;
+  double wins[MEEPLE_COLOR_COUNT];
+  int64_t points[MEEPLE_COLOR_COUNT];
+  int engine_errors[MEEPLE_COLOR_COUNT];
+} SimBatch;
+
+/** Rozgrywa jedną grę w obecnym wątku. Kilka gier można rozgrywać równolegle w osobnych wątkach */
+void sim_play(const SimConfig *cfg, SimResult *result);
+
+/**
+ * Rozgrywa `games` gier w `threads` wątkach. Gra `i` ma ziarno `seed + i`, więc wyniki nie zależą od liczby
+ * wątków. Każdy wątek dostaje na początku równą część gier, a gdy skończy swoje, zabiera połowę pozostałych
+ * gier innemu wątkowi. `results` (może być NULL) dostaje wyniki poszczególnych gier
+ */
+SimBatch sim_run_batch(const SimConfig *cfg, int games, int threads, uint64_t seed, SimResult *results);
+
+#endif
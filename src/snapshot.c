@@ -0,0 +1,39 @@
+#include <string.h>
+
+#include "./snapshot.h"
+
+static bool snapshot_valid(const Snapshot *s)
+{
+  return !memcmp(s->magic, SNAPSHOT_MAGIC, 4) && s->version == SNAPSHOT_VERSION && s->size == sizeof(Snapshot);
+}
+
+void snapshot_take(Snapshot *s)
+{
+  memset(s, 0, sizeof(Snapshot));
+  memcpy(s->magic, SNAPSHOT_MAGIC, 4);
+  s->version = SNAPSHOT_VERSION;
+  s->size = sizeof(Snapshot);
+
+  game_clone(&s->state);
+}
+
+bool snapshot_restore(const Snapshot *s)
+{
+  if (!snapshot_valid(s))
+    return false;
+
+  match = s->state.m;
+  deck_load(&s->state.deck);
+  board_load(&s->state.board);
+  return true;
+}
+
+bool snapshot_write(const Snapshot *s, FILE *f)
+{
+  return fwrite(s, sizeof(Snapshot), 1, f) == 1;
+}
+
+bool snapshot_read(Snapshot *s, FILE *f)
+{
+  return fread(s, sizeof(Snapshot), 1, f) == 1 && snapshot_valid(s);
+}
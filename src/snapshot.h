@@ -0,0 +1,34 @@
+#ifndef __snapshot_inc
+#define __snapshot_inc
+
+#include <stdio.h>
+
+#include "./match.h"
+
+/**
+ * Zapis stanu gry w dowolnym momencie: plansza, kolejność płytek w stosie, gracze, obecny ruch
+ * i stan generatora liczb losowych. Struktura nie zawiera wskaźników, więc jest zapisywana i odczytywana
+ * jednym kopiowaniem. Układ zależy od kompilatora i architektury, dlatego nagłówek zawiera wersję
+ * i rozmiar struktury - plik z innej wersji programu zostanie odrzucony.
+ */
+#define SNAPSHOT_MAGIC "CSNP"
+#define SNAPSHOT_VERSION 2
+
+typedef struct Snapshot
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t size;
+  GameState state;
+} Snapshot;
+
+/** Zapisuje stan gry z obecnego wątku */
+void snapshot_take(Snapshot *s);
+/** Przywraca stan gry w obecnym wątku. Zwraca false, jeżeli nagłówek się nie zgadza */
+bool snapshot_restore(const Snapshot *s);
+
+bool snapshot_write(const Snapshot *s, FILE *f);
+/** Odczytuje zapis z pliku i sprawdza nagłówek */
+bool snapshot_read(Snapshot *s, FILE *f);
+
+#endif
@@ -1,53 +1,213 @@
 #include <allegro5/allegro.h>
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "./board.h"
 #include "./resources.h"
 #include "./spring.h"
+#include "./utils.h"
 
 // Spring
 
 #define SPRING_PI 3.141592653589793
-#define SPRING_DT 0.04
-#define SPRING_SQ(v) (v * v)
+/** Tłumienie tak bliskie krytycznemu jest liczone jak krytyczne (wzory dla pozostałych przypadków dzielą przez 0) */
+#define SPRING_CRITICAL_EPS 1e-3
 
-void spring_init(Spring *s, float r, float d)
+/**
+ * Macierz przejścia o czas `t` dla częstości `w` i tłumienia `z`. Odchylenie od celu `y` spełnia y'' = -ω²y - 2ζωy',
+ * więc po czasie t (y, v) = m * (y0, v0), gdzie m wynika z rozwiązania dla tłumienia słabego, krytycznego i silnego
+ */
+static void spring_matrix_wz(double w, double z, double t, float m[4])
 {
-  s->target = s->value = s->velocity = 0;
-  spring_set_config(s, r, d);
+  double m00, m01, m10, m11;
+
+  if (fabs(z - 1) < SPRING_CRITICAL_EPS)
+  {
+    double e = exp(-w * t);
+    m00 = e * (1 + w * t);
+    m01 = e * t;
+    m10 = -e * w * w * t;
+    m11 = e * (1 - w * t);
+  }
+  else if (z < 1)
+  {
+    double wd = w * sqrt(1 - z * z), e = exp(-z * w * t);
+    double c = cos(wd * t), s = sin(wd * t);
+    m00 = e * (c + z * w / wd * s);
+    m01 = e * s / wd;
+    m10 = -e * w * w / wd * s;
+    m11 = e * (c - z * w / wd * s);
+  }
+  else
+  {
+    double r1 = -w * (z - sqrt(z * z - 1)), r2 = -w * (z + sqrt(z * z - 1));
+    double e1 = exp(r1 * t), e2 = exp(r2 * t), d = r1 - r2;
+    m00 = (r1 * e2 - r2 * e1) / d;
+    m01 = (e1 - e2) / d;
+    m10 = w * w * (e2 - e1) / d;
+    m11 = (r1 * e1 - r2 * e2) / d;
+  }
+
+  m[0] = m00;
+  m[1] = m01;
+  m[2] = m10;
+  m[3] = m11;
 }
 
-void spring_set_config(Spring *s, float r, float d)
+void spring_transition(float r, float d, float dt, float m[4])
 {
-  s->k = (4 * SPRING_SQ(SPRING_PI)) / SPRING_SQ(d);
-  s->c = 2 * r * sqrt(s->k);
+  spring_matrix_wz(2 * SPRING_PI / d, r, dt, m);
 }
 
-void spring_update(Spring *s, float dt)
+/** Macierz przejścia o krok `p->dt` dla sprężyny na miejscu `i` */
+static void spring_matrix(SpringPool *p, int i)
 {
-  if (spring_at_rest(s))
-  {
-    s->value = s->target;
-    s->velocity = 0;
+  float m[4];
+  spring_matrix_wz(p->omega[i], p->zeta[i], p->dt, m);
+  p->m00[i] = m[0];
+  p->m01[i] = m[1];
+  p->m10[i] = m[2];
+  p->m11[i] = m[3];
+}
+
+#define SPRING_SWAP(A)                                                                                                 \
+  do                                                                                                                   \
+  {                                                                                                                    \
+    __typeof__(p->A[0]) tmp = p->A[a];                                                                                 \
+    p->A[a] = p->A[b];                                                                                                 \
+    p->A[b] = tmp;                                                                                                     \
+  } while (0)
+
+/** Zamienia miejscami sprężyny na miejscach `a` i `b` */
+static void spring_swap(SpringPool *p, int a, int b)
+{
+  if (a == b)
     return;
-  }
 
-  float a;
+  SPRING_SWAP(value);
+  SPRING_SWAP(target);
+  SPRING_SWAP(velocity);
+  SPRING_SWAP(prev);
+  SPRING_SWAP(omega);
+  SPRING_SWAP(zeta);
+  SPRING_SWAP(m00);
+  SPRING_SWAP(m01);
+  SPRING_SWAP(m10);
+  SPRING_SWAP(m11);
+  SPRING_SWAP(id);
+  p->slot[p->id[a]] = a;
+  p->slot[p->id[b]] = b;
+}
+
+/** Przenosi sprężynę do części w ruchu albo z niej */
+static void spring_set_active(SpringPool *p, Spring s, bool active)
+{
+  int i = p->slot[s];
+  if (active && i >= p->active)
+    spring_swap(p, i, p->active++);
+  else if (!active && i < p->active)
+    spring_swap(p, i, --p->active);
+}
+
+Spring spring_add(SpringPool *p, float r, float d)
+{
+  ASSERTF((p->count < SPRING_POOL_SIZE), "spring pool overflow");
+
+  Spring s = p->count++;
+  p->slot[s] = p->id[s] = s;
+  p->value[s] = p->target[s] = p->velocity[s] = p->prev[s] = 0;
+  spring_set_config(p, s, r, d);
+  return s;
+}
+
+void spring_set_config(SpringPool *p, Spring s, float r, float d)
+{
+  int i = p->slot[s];
+  p->omega[i] = 2 * SPRING_PI / d;
+  p->zeta[i] = r;
+  spring_matrix(p, i);
+}
+
+void spring_set_target(SpringPool *p, Spring s, float target)
+{
+  int i = p->slot[s];
+  p->target[i] = target;
+  // Sprężyna w ruchu porusza się dalej, nawet jeżeli cel jest dokładnie w jej obecnym położeniu
+  spring_set_active(p, s, p->value[i] != target || p->velocity[i] != 0);
+}
+
+float spring_target(const SpringPool *p, Spring s)
+{
+  return p->target[p->slot[s]];
+}
+
+void spring_jump(SpringPool *p, Spring s, float value)
+{
+  int i = p->slot[s];
+  p->value[i] = p->prev[i] = value;
+  p->velocity[i] = 0;
+  spring_set_active(p, s, value != p->target[i]);
+}
 
-  while (dt > 0)
+bool spring_at_rest(const SpringPool *p, Spring s)
+{
+  return p->slot[s] >= p->active;
+}
+
+#define __S_BETWEEN(V, E) (-(E) < (V) && (V) < (E))
+
+bool spring_pool_update(SpringPool *p, float dt)
+{
+  if (!p->active)
+    return false;
+
+  if (p->dt != dt)
+  {
+    p->dt = dt;
+    for (int i = 0; i < p->count; i++)
+      spring_matrix(p, i);
+  }
+
+  for (int i = 0; i < p->active; i++)
   {
-    a = s->k * (s->value - s->target) + s->c * s->velocity;
-    s->velocity -= a * (dt > SPRING_DT ? SPRING_DT : dt);
-    s->value += s->velocity * (dt > SPRING_DT ? SPRING_DT : dt);
-    dt -= SPRING_DT;
+    float y = p->value[i] - p->target[i], v = p->velocity[i];
+    p->prev[i] = p->value[i];
+    p->value[i] = p->target[i] + p->m00[i] * y + p->m01[i] * v;
+    p->velocity[i] = p->m10[i] * y + p->m11[i] * v;
   }
+
+  // Sprężyny w spoczynku są ustawiane dokładnie na cel i wypadają z części w ruchu. Ostatni krok jest bez
+  // interpolacji, ale różnica jest mniejsza niż SPRING_EPS
+  for (int i = p->active - 1; i >= 0; i--)
+    if (__S_BETWEEN(p->value[i] - p->target[i], SPRING_EPS) && __S_BETWEEN(p->velocity[i], SPRING_EPS))
+    {
+      p->value[i] = p->prev[i] = p->target[i];
+      p->velocity[i] = 0;
+      spring_swap(p, i, --p->active);
+    }
+
+  return true;
+}
+
+static float spring_alpha = 1;
+
+float spring_lerp(float prev, float value)
+{
+  return prev + (value - prev) * spring_alpha;
+}
+
+float spring_value(const SpringPool *p, Spring s)
+{
+  int i = p->slot[s];
+  return spring_lerp(p->prev[i], p->value[i]);
 }
 
 // View
 
 View view;
 
+static SpringPool view_pool;
 static struct ViewSprings
 {
   Spring x, y, s;
@@ -55,59 +215,88 @@ static struct ViewSprings
 
 void view_init()
 {
-  view_springs.x.value = -BOARD_CENTER;
-  view_springs.y.value = -BOARD_CENTER;
-  view_springs.s.value = 32;
+  memset(&view_pool, 0, sizeof(view_pool));
+  view_springs.x = spring_add(&view_pool, 1, 10);
+  view_springs.y = spring_add(&view_pool, 1, 10);
+  view_springs.s = spring_add(&view_pool, 1, 10);
+
+  spring_jump(&view_pool, view_springs.x, -BOARD_CENTER);
+  spring_jump(&view_pool, view_springs.y, -BOARD_CENTER);
+  spring_jump(&view_pool, view_springs.s, 32);
   view_blur();
 }
 
-void view_tick(float dt)
+/** Wartość sprężyny widoku po ostatnim kroku, bez interpolacji */
+static float view_spring(Spring s)
+{
+  return view_pool.value[view_pool.slot[s]];
+}
+
+bool view_tick(float dt)
 {
-  spring_update(&view_springs.x, dt);
-  spring_update(&view_springs.y, dt);
-  spring_update(&view_springs.s, dt);
+  bool moved = spring_pool_update(&view_pool, dt);
+
+  view.x = view_spring(view_springs.x);
+  view.y = view_spring(view_springs.y);
+  view.s = view_spring(view_springs.s);
+  return moved;
+}
 
-  view.x = view_springs.x.value;
-  view.y = view_springs.y.value;
-  view.s = view_springs.s.value;
+void spring_interpolate(float alpha)
+{
+  spring_alpha = alpha;
+  view.x = spring_value(&view_pool, view_springs.x);
+  view.y = spring_value(&view_pool, view_springs.y);
+  view.s = spring_value(&view_pool, view_springs.s);
 }
 
 void view_set(int x, int y)
 {
-  view_springs.x.target = x;
-  view_springs.y.target = y;
+  spring_set_target(&view_pool, view_springs.x, x);
+  spring_set_target(&view_pool, view_springs.y, y);
+}
+
+/** Przesuwa widok od razu na docelową pozycję, bez animacji */
+void view_snap()
+{
+  spring_jump(&view_pool, view_springs.x, spring_target(&view_pool, view_springs.x));
+  spring_jump(&view_pool, view_springs.y, spring_target(&view_pool, view_springs.y));
 }
 
 void view_zoom_in()
 {
-  if (view_springs.s.target < 256)
-    view_springs.s.target *= 2;
+  float s = spring_target(&view_pool, view_springs.s);
+  if (s < 256)
+    spring_set_target(&view_pool, view_springs.s, s * 2);
 }
 
 void view_zoom_out()
 {
-  if (view_springs.s.target > 8)
-    view_springs.s.target /= 2;
+  float s = spring_target(&view_pool, view_springs.s);
+  if (s > 8)
+    spring_set_target(&view_pool, view_springs.s, s / 2);
 }
 
-void view_focus()
+/** Ustawia wszystkim sprężynom widoku ten sam czas ruchu */
+static void view_set_config(float duration_s)
 {
-  spring_set_config(&view_springs.x, 1, 1);
-  spring_set_config(&view_springs.y, 1, 1);
-  spring_set_config(&view_springs.s, 1, 1);
+  spring_set_config(&view_pool, view_springs.x, 1, duration_s);
+  spring_set_config(&view_pool, view_springs.y, 1, duration_s);
+  spring_set_config(&view_pool, view_springs.s, 1, duration_s);
+}
 
-  view_springs.x.target = -BOARD_CENTER;
-  view_springs.y.target = -BOARD_CENTER;
-  view_springs.s.target = 64;
+void view_focus()
+{
+  view_set_config(1);
+  spring_set_target(&view_pool, view_springs.x, -BOARD_CENTER);
+  spring_set_target(&view_pool, view_springs.y, -BOARD_CENTER);
+  spring_set_target(&view_pool, view_springs.s, 64);
 }
 
 void view_blur()
 {
-  spring_set_config(&view_springs.x, 1, 10);
-  spring_set_config(&view_springs.y, 1, 10);
-  spring_set_config(&view_springs.s, 1, 10);
-
-  view_springs.x.target = (view_springs.x.target - BOARD_CENTER) / 2;
-  view_springs.y.target = (view_springs.y.target - BOARD_CENTER) / 2;
-  view_springs.s.target = 32;
+  view_set_config(10);
+  spring_set_target(&view_pool, view_springs.x, (spring_target(&view_pool, view_springs.x) - BOARD_CENTER) / 2);
+  spring_set_target(&view_pool, view_springs.y, (spring_target(&view_pool, view_springs.y) - BOARD_CENTER) / 2);
+  spring_set_target(&view_pool, view_springs.s, 32);
 }
@@ -1,23 +1,66 @@
 #ifndef __spring_inc
 #define __spring_inc
 
+#include <stdbool.h>
+#include <stdint.h>
+
 // Spring
 
-typedef struct Spring
-{
-  float value, target;
-  float velocity;
-  float k, c;
-} Spring;
+/** Największa liczba sprężyn w jednej puli */
+#define SPRING_POOL_SIZE 32
 
-#define __S_BETWEEN(V, E) (-(E) < (V) && (V) < (E))
+/** Numer sprężyny w puli (z `spring_add()`), niezależny od jej miejsca w tablicach */
+typedef uint8_t Spring;
+
+/**
+ * Pula sprężyn jako struktura tablic. Sprężyny w ruchu zajmują początek tablic (`0..active-1`), więc krok całej
+ * puli to jedna pętla bez rozgałęzień. Sprężyna, która się zatrzymała, wypada z tej części i nie kosztuje nic.
+ *
+ * Krok jest dokładnym rozwiązaniem równania tłumionego oscylatora, niezależnie od `dt`: stan (odchylenie od celu,
+ * prędkość) jest mnożony przez macierz przejścia `m`, liczoną raz dla danego `dt` i konfiguracji sprężyny
+ */
+typedef struct SpringPool
+{
+  int count, active;
+  /** Krok, dla którego policzono macierze przejścia */
+  float dt;
+  float value[SPRING_POOL_SIZE], target[SPRING_POOL_SIZE], velocity[SPRING_POOL_SIZE];
+  /** Wartość przed ostatnim krokiem, do interpolacji przy rysowaniu (zob. `spring_interpolate()`) */
+  float prev[SPRING_POOL_SIZE];
+  /** Częstość drgań nietłumionych i współczynnik tłumienia */
+  float omega[SPRING_POOL_SIZE], zeta[SPRING_POOL_SIZE];
+  float m00[SPRING_POOL_SIZE], m01[SPRING_POOL_SIZE], m10[SPRING_POOL_SIZE], m11[SPRING_POOL_SIZE];
+  /** Miejsce w tablicach według numeru sprężyny i numer sprężyny według miejsca */
+  uint8_t slot[SPRING_POOL_SIZE], id[SPRING_POOL_SIZE];
+} SpringPool;
 
 #define SPRING_EPS 0.01
-#define spring_at_rest(S) (__S_BETWEEN((S)->value - (S)->target, SPRING_EPS) && __S_BETWEEN((S)->velocity, SPRING_EPS))
 
-void spring_init(Spring *spring, float ratio, float duration_s);
-void spring_set_config(Spring *spring, float ratio, float duration_s);
-void spring_update(Spring *spring, float dt);
+/** Dodaje sprężynę w spoczynku w 0. Pula musi być wcześniej wyzerowana */
+Spring spring_add(SpringPool *pool, float ratio, float duration_s);
+void spring_set_config(SpringPool *pool, Spring spring, float ratio, float duration_s);
+void spring_set_target(SpringPool *pool, Spring spring, float target);
+float spring_target(const SpringPool *pool, Spring spring);
+/** Ustawia wartość od razu, bez animacji */
+void spring_jump(SpringPool *pool, Spring spring, float value);
+bool spring_at_rest(const SpringPool *pool, Spring spring);
+/** Krok wszystkich sprężyn w ruchu. Zwraca false, jeżeli wszystkie były w spoczynku (nic się nie zmieniło) */
+bool spring_pool_update(SpringPool *pool, float dt);
+/**
+ * Macierz przejścia `m` (m00, m01, m10, m11) o krok `dt` dla sprężyny o danej konfiguracji, dla wielu obiektów
+ * animowanych tak samo, ale trzymanych poza pulą sprężyn (zob. `particles`)
+ */
+void spring_transition(float ratio, float duration_s, float dt, float m[4]);
+
+/**
+ * Symulacja działa stałymi krokami, a klatka jest rysowana między dwoma ostatnimi krokami: `alpha` to część kroku,
+ * która minęła od ostatniego kroku. Ustawia też `view` na wartości do rysowania
+ */
+void spring_interpolate(float alpha);
+/** Wartość sprężyny do rysowania (interpolowana) */
+float spring_value(const SpringPool *pool, Spring spring);
+/** Wartość do rysowania między wartością przed ostatnim krokiem a obecną */
+float spring_lerp(float prev, float value);
 
 // View
 
@@ -29,10 +72,12 @@ typedef struct View
 extern View view;
 
 void view_init();
-void view_tick(float dt);
+/** Zwraca true, jeżeli widok się zmienił */
+bool view_tick(float dt);
 void view_render();
 
 void view_set(int x, int y);
+void view_snap();
 void view_zoom_in();
 void view_zoom_out();
 void view_focus();
@@ -0,0 +1,201 @@
+#include <math.h>
+#include <string.h>
+
+#include "./match.h"
+#include "./stats.h"
+
+/** Szkic: przedział k > 0 obejmuje wartości (SKETCH_MIN * γ^(k-1), SKETCH_MIN * γ^k], gdzie γ = (1+α)/(1-α) */
+#define SKETCH_MIN 1e-3
+#define SKETCH_ALPHA 0.01
+#define SKETCH_GAMMA ((1 + SKETCH_ALPHA) / (1 - SKETCH_ALPHA))
+
+static const char *TYPE_NAMES[STATS_TILE_TYPES] = {"none", "field", "road", "city", "monastery"};
+
+// Histogram and sketch
+
+/** Numer elementu (od 0) będącego kwantylem `q` z `count` posortowanych elementów */
+static uint64_t stats_rank(uint64_t count, double q)
+{
+  uint64_t rank = q * count;
+  return rank < count ? rank : count - 1;
+}
+
+void stats_hist_add(StatsHist *h, int value)
+{
+  h->count++;
+  h->bins[value < 0 ? 0 : value > STATS_SCORE_MAX ? STATS_SCORE_MAX : value]++;
+}
+
+int stats_hist_quantile(const StatsHist *h, double q)
+{
+  if (!h->count)
+    return 0;
+
+  uint64_t rank = stats_rank(h->count, q), seen = 0;
+  for (int i = 0; i <= STATS_SCORE_MAX; i++)
+    if ((seen += h->bins[i]) > rank)
+      return i;
+  return STATS_SCORE_MAX;
+}
+
+double stats_hist_mean(const StatsHist *h, double *std)
+{
+  double sum = 0, sq = 0;
+  for (int i = 0; i <= STATS_SCORE_MAX; i++)
+    sum += (double)h->bins[i] * i;
+
+  double mean = h->count ? sum / h->count : 0;
+  for (int i = 0; i <= STATS_SCORE_MAX; i++)
+    sq += h->bins[i] * (i - mean) * (i - mean);
+
+  *std = h->count ? sqrt(sq / h->count) : 0;
+  return mean;
+}
+
+void stats_sketch_add(StatsSketch *s, double value)
+{
+  if (!s->count || value < s->min)
+    s->min = value;
+  if (!s->count || value > s->max)
+    s->max = value;
+  s->count++;
+  s->sum += value;
+
+  int k = value <= SKETCH_MIN ? 0 : (int)ceil(log(value / SKETCH_MIN) / log(SKETCH_GAMMA));
+  s->bins[k < STATS_SKETCH_BINS ? k : STATS_SKETCH_BINS - 1]++;
+}
+
+double stats_sketch_quantile(const StatsSketch *s, double q)
+{
+  if (!s->count)
+    return 0;
+
+  uint64_t rank = stats_rank(s->count, q), seen = 0;
+  int k = 0;
+  while (k < STATS_SKETCH_BINS - 1 && (seen += s->bins[k]) <= rank)
+    k++;
+
+  // Środek przedziału w sensie błędu względnego, ograniczony rzeczywistym minimum i maksimum
+  double v = k ? SKETCH_MIN * pow(SKETCH_GAMMA, k - 1) * 2 * SKETCH_GAMMA / (1 + SKETCH_GAMMA) : SKETCH_MIN;
+  return v < s->min ? s->min : v > s->max ? s->max : v;
+}
+
+// Events
+
+void stats_score(GameStats *s, int seat, int points, TileType type)
+{
+  s->feature_points[seat][type] += points;
+  s->feature_count[seat][type]++;
+}
+
+void stats_turn(GameStats *s, int seat, const Turn *turn, int meeple_left, float move_ms)
+{
+  int tile = turn->tile.bitmap % STATS_TILE_KINDS;
+
+  s->turns[seat]++;
+  s->meeple_in_use[seat] += MATCH_MEEPLE - meeple_left;
+  if (!meeple_left)
+    s->meeple_starved[seat]++;
+
+  if (turn->skip)
+  {
+    s->tile_skipped[tile]++;
+    return;
+  }
+
+  s->tile_placed[tile]++;
+  stats_sketch_add(&s->move_ms[seat], move_ms);
+  if (turn->meeple.color != MeepleNone)
+    s->meeple_placed[seat][turn->tile.types[turn->meeple.pos]]++;
+}
+
+void stats_game_end(GameStats *s, const Player *players, int count)
+{
+  s->games++;
+  for (int i = 0; i < count; i++)
+    stats_hist_add(&s->score[i], players[i].points);
+}
+
+// Merging and output
+
+/** Dodaje tablice liczników (także struktury złożone tylko z `uint64_t`) */
+static void stats_add(void *dst, const void *src, size_t size)
+{
+  for (size_t i = 0; i < size / sizeof(uint64_t); i++)
+    ((uint64_t *)dst)[i] += ((const uint64_t *)src)[i];
+}
+
+#define MERGE(FIELD) stats_add(&dst->FIELD, &src->FIELD, sizeof(dst->FIELD))
+
+void stats_merge(GameStats *dst, const GameStats *src)
+{
+  dst->games += src->games;
+  MERGE(score);
+  MERGE(feature_points);
+  MERGE(feature_count);
+  MERGE(meeple_placed);
+  MERGE(meeple_in_use);
+  MERGE(meeple_starved);
+  MERGE(turns);
+  MERGE(tile_placed);
+  MERGE(tile_skipped);
+
+  for (int i = 0; i < MEEPLE_COLOR_COUNT; i++)
+  {
+    StatsSketch *d = &dst->move_ms[i];
+    const StatsSketch *s = &src->move_ms[i];
+    if (!s->count)
+      continue;
+
+    d->min = !d->count || s->min < d->min ? s->min : d->min;
+    d->max = !d->count || s->max > d->max ? s->max : d->max;
+    d->count += s->count;
+    d->sum += s->sum;
+    for (int k = 0; k < STATS_SKETCH_BINS; k++)
+      d->bins[k] += s->bins[k];
+  }
+}
+
+void stats_write_json(const GameStats *s, int players, FILE *f)
+{
+  fprintf(f, "{\"games\":%llu,\"seats\":[", (unsigned long long)s->games);
+
+  for (int i = 0; i < players; i++)
+  {
+    const StatsHist *h = &s->score[i];
+    const StatsSketch *m = &s->move_ms[i];
+    double std, mean = stats_hist_mean(h, &std);
+    double turns = s->turns[i] ? s->turns[i] : 1;
+
+    fprintf(f,
+            "%s{\"seat\":%d,\"score\":{\"mean\":%.2f,\"std\":%.2f,\"min\":%d,\"p10\":%d,\"p50\":%d,\"p90\":%d,"
+            "\"max\":%d},",
+            i ? "," : "", i, mean, std, stats_hist_quantile(h, 0), stats_hist_quantile(h, 0.1),
+            stats_hist_quantile(h, 0.5), stats_hist_quantile(h, 0.9), stats_hist_quantile(h, 1));
+    fprintf(f, "\"move_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f},",
+            m->count ? m->sum / m->count : 0, stats_sketch_quantile(m, 0.5), stats_sketch_quantile(m, 0.99), m->max);
+
+    fprintf(f, "\"points\":{");
+    for (int t = TileTypeField; t < STATS_TILE_TYPES; t++)
+      fprintf(f, "%s\"%s\":{\"total\":%llu,\"features\":%llu}", t > TileTypeField ? "," : "", TYPE_NAMES[t],
+              (unsigned long long)s->feature_points[i][t], (unsigned long long)s->feature_count[i][t]);
+
+    fprintf(f, "},\"meeple\":{\"placed\":{");
+    for (int t = TileTypeField; t < STATS_TILE_TYPES; t++)
+      fprintf(f, "%s\"%s\":%llu", t > TileTypeField ? "," : "", TYPE_NAMES[t],
+              (unsigned long long)s->meeple_placed[i][t]);
+    fprintf(f, "},\"mean_in_use\":%.3f,\"starved_rate\":%.4f}}", s->meeple_in_use[i] / turns,
+            s->meeple_starved[i] / turns);
+  }
+
+  fprintf(f, "],\"tiles\":[");
+  for (int t = 0, first = 1; t < STATS_TILE_KINDS; t++)
+    if (s->tile_placed[t] || s->tile_skipped[t])
+    {
+      fprintf(f, "%s{\"tile\":%d,\"placed\":%llu,\"skipped\":%llu}", first ? "" : ",", t,
+              (unsigned long long)s->tile_placed[t], (unsigned long long)s->tile_skipped[t]);
+      first = 0;
+    }
+
+  fprintf(f, "]}\n");
+}
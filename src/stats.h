@@ -0,0 +1,76 @@
+#ifndef __stats_inc
+#define __stats_inc
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "./game.h"
+
+/**
+ * Statystyki wielu gier zbierane na bieżąco, w stałej pamięci (ok. 60 KB), bez przechowywania
+ * wyników poszczególnych gier. Każdy wątek zbiera własne statystyki, a na końcu są one łączone (`stats_merge()`).
+ */
+
+/** Punkty końcowe są liczone dokładnie do tej wartości, wyższe trafiają do ostatniego przedziału */
+#define STATS_SCORE_MAX 511
+/** Numery bitmap płytek mieszczą się na 5 bitach (jak w zapisie gry) */
+#define STATS_TILE_KINDS 32
+#define STATS_TILE_TYPES (TileTypeMonastery + 1)
+
+/** Histogram liczb całkowitych 0..STATS_SCORE_MAX. Kwantyle są dokładne */
+typedef struct StatsHist
+{
+  uint64_t count;
+  uint64_t bins[STATS_SCORE_MAX + 1];
+} StatsHist;
+
+/**
+ * Szkic kwantyli dla liczb dodatnich: przedziały rosnące wykładniczo (jak w DDSketch), więc kwantyl jest
+ * przybliżony z błędem względnym ok. 1% w zakresie od 1 µs do kilku minut (wartości w milisekundach)
+ */
+#define STATS_SKETCH_BINS 1024
+typedef struct StatsSketch
+{
+  uint64_t count;
+  double sum, min, max;
+  uint64_t bins[STATS_SKETCH_BINS];
+} StatsSketch;
+
+typedef struct GameStats
+{
+  uint64_t games;
+  /** Punkty końcowe i czas namysłu według miejsca przy stole */
+  StatsHist score[MEEPLE_COLOR_COUNT];
+  StatsSketch move_ms[MEEPLE_COLOR_COUNT];
+  /** Punkty i liczba punktowanych obiektów według miejsca i typu obiektu */
+  uint64_t feature_points[MEEPLE_COLOR_COUNT][STATS_TILE_TYPES];
+  uint64_t feature_count[MEEPLE_COLOR_COUNT][STATS_TILE_TYPES];
+  /** Postawieni podwładni według typu obiektu, suma podwładnych na planszy w każdym ruchu i ruchy bez podwładnych */
+  uint64_t meeple_placed[MEEPLE_COLOR_COUNT][STATS_TILE_TYPES];
+  uint64_t meeple_in_use[MEEPLE_COLOR_COUNT];
+  uint64_t meeple_starved[MEEPLE_COLOR_COUNT];
+  uint64_t turns[MEEPLE_COLOR_COUNT];
+  /** Położone i pominięte płytki według numeru bitmapy */
+  uint64_t tile_placed[STATS_TILE_KINDS];
+  uint64_t tile_skipped[STATS_TILE_KINDS];
+} GameStats;
+
+void stats_hist_add(StatsHist *h, int value);
+int stats_hist_quantile(const StatsHist *h, double q);
+/** Średnia, a w `std` odchylenie standardowe */
+double stats_hist_mean(const StatsHist *h, double *std);
+void stats_sketch_add(StatsSketch *s, double value);
+double stats_sketch_quantile(const StatsSketch *s, double q);
+
+/** Punkty zdobyte przez gracza (z `match_score_cb`) */
+void stats_score(GameStats *s, int seat, int points, TileType type);
+/** Ruch gracza przed `match_turn_end()`. meeple_left - podwładni gracza przed ruchem */
+void stats_turn(GameStats *s, int seat, const Turn *turn, int meeple_left, float move_ms);
+void stats_game_end(GameStats *s, const Player *players, int count);
+
+/** Dodaje statystyki `src` do `dst` */
+void stats_merge(GameStats *dst, const GameStats *src);
+/** Zapisuje statystyki jako jeden obiekt JSON */
+void stats_write_json(const GameStats *s, int players, FILE *f);
+
+#endif
@@ -0,0 +1,77 @@
+#include <allegro5/allegro_font.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "./profile.h"
+#include "./resources.h"
+#include "./text.h"
+#include "./utils.h"
+
+static void text_update(TextCache *c, const char *text)
+{
+  snprintf(c->text, sizeof(c->text), "%s", text);
+
+  int bx, by, bw, bh;
+  al_get_text_dimensions(fonts.ui, c->text, &bx, &by, &bw, &bh);
+  c->width = al_get_text_width(fonts.ui, c->text);
+
+  // Bitmapa zaczyna się w punkcie rysowania tekstu i obejmuje też glify wystające poza jego szerokość
+  int w = bx + bw > c->width ? bx + bw : c->width, h = al_get_font_line_height(fonts.ui);
+  h = by + bh > h ? by + bh : h;
+
+  text_free(c);
+  c->bitmap = al_create_bitmap(w > 0 ? w : 1, h > 0 ? h : 1);
+  MUST_INIT(c->bitmap, "text bitmap");
+
+  // Zmiana bitmapy docelowej nie jest dozwolona w trakcie `al_hold_bitmap_drawing()`
+  bool held = al_is_bitmap_drawing_held();
+  if (held)
+    al_hold_bitmap_drawing(false);
+
+  ALLEGRO_STATE state;
+  al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+  al_set_target_bitmap(c->bitmap);
+  al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+  al_draw_text(fonts.ui, al_map_rgb_f(1, 1, 1), 0, 0, ALLEGRO_ALIGN_LEFT, c->text);
+  al_restore_state(&state);
+
+  if (held)
+    al_hold_bitmap_drawing(true);
+}
+
+static void text_blit(TextCache *c, float x, float y, int align)
+{
+  if (align & ALLEGRO_ALIGN_CENTER)
+    x -= c->width / 2.0;
+  else if (align & ALLEGRO_ALIGN_RIGHT)
+    x -= c->width;
+
+  al_draw_bitmap(c->bitmap, x, y, 0);
+  PROFILE_DRAW(1);
+}
+
+void text_draw(TextCache *c, float x, float y, int align, const char *text)
+{
+  if (!c->bitmap || strcmp(c->text, text))
+    text_update(c, text);
+  text_blit(c, x, y, align);
+}
+
+void text_draw_int(TextCache *c, float x, float y, int align, int value)
+{
+  if (!c->bitmap || c->value != value)
+  {
+    char text[16];
+    snprintf(text, sizeof(text), "%d", value);
+    text_update(c, text);
+    c->value = value;
+  }
+  text_blit(c, x, y, align);
+}
+
+void text_free(TextCache *c)
+{
+  if (c->bitmap)
+    al_destroy_bitmap(c->bitmap);
+  c->bitmap = NULL;
+}
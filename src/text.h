@@ -0,0 +1,25 @@
+#ifndef __text_inc
+#define __text_inc
+
+#include <allegro5/allegro.h>
+
+/**
+ * Napis narysowany raz na osobnej bitmapie (czcionką `fonts.ui`, na biało). Co klatkę rysowana jest tylko ta
+ * bitmapa, a tekst jest składany z glifów na nowo dopiero po jego zmianie
+ */
+typedef struct TextCache
+{
+  ALLEGRO_BITMAP *bitmap;
+  /** Szerokość tekstu (jak `al_get_text_width()`), używana przy wyrównaniu */
+  int width;
+  char text[32];
+  int value;
+} TextCache;
+
+/** Rysuje tekst jak `al_draw_text()`. Bitmapa jest tworzona na nowo tylko wtedy, gdy tekst się zmienił */
+void text_draw(TextCache *c, float x, float y, int align, const char *text);
+/** Rysuje liczbę. Nie jest nawet formatowana, dopóki się nie zmieni. Nie należy mieszać z `text_draw()` */
+void text_draw_int(TextCache *c, float x, float y, int align, int value);
+void text_free(TextCache *c);
+
+#endif
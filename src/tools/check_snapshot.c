@@ -0,0 +1,112 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../board.h"
+#include "../bot.h"
+#include "../deck.h"
+#include "../match.h"
+#include "../sim.h"
+#include "../snapshot.h"
+#include "../utils.h"
+
+/**
+ * Sprawdzanie zapisu gry w trakcie ruchu
+ * Zapisuje gry w fazie stawiania podwładnego, gdy płytka leży już na planszy tymczasowo (`board_tile_tmp()`, jak
+ * po ENTER w grze). Zapis nie może zawierać tymczasowej płytki, a wczytana gra jest rozgrywana przez boty do końca
+ * w innym wątku, w którym wskaźnik na tymczasową płytkę nie istnieje. Przykład: check_snapshot -n 200
+ */
+
+#define THREAD_STACK_SIZE (16 << 20)
+#define PLAYERS 3
+
+static int games = 100;
+static int failures;
+
+/** Rozgrywa grę do ruchu `turn` i zapisuje ją po położeniu płytki. Zwraca false, jeżeli gra skończyła się wcześniej */
+static bool save_in_meeple_phase(uint64_t seed, int turn, Snapshot *s)
+{
+  match_init(0, PLAYERS, seed, NULL);
+
+  for (int i = 0; !match.finished; i++)
+  {
+    if (!match_turn_start())
+      match.turn.skip = true;
+    else
+    {
+      bot_turn(match_current(), &match.turn, deck_size() / match.count, &match.rng);
+      if (i >= turn)
+      {
+        board_tile_tmp(&match.turn.tile, match.turn.x, match.turn.y);
+        snapshot_take(s);
+        board_tile_tmp(NULL, match.turn.x, match.turn.y);
+        return true;
+      }
+    }
+    match_turn_end();
+  }
+
+  return false;
+}
+
+static void *worker(void *arg)
+{
+  UNUSED(arg);
+
+  static Snapshot s;
+  for (int g = 0; g < games; g++)
+  {
+    if (!save_in_meeple_phase(g, g % (TILE_COUNT / 2), &s))
+      continue;
+
+    for (int y = 0; y <= BOARD_SIZE; y++)
+      for (int x = 0; x <= BOARD_SIZE; x++)
+        if (s.state.board.grid[y][x] == BOARD_TILE_TMP)
+        {
+          fprintf(stderr, "game %d: temporary tile saved at %d,%d\n", g, x, y);
+          failures++;
+        }
+
+    // Dalsza gra w nowym wątku kończy się albo błędem (jak przed poprawką), albo poprawnym wynikiem
+    SimConfig cfg = {.players = PLAYERS, .start = &s};
+    SimResult result;
+    sim_run_batch(&cfg, 1, 1, g, &result);
+  }
+
+  return NULL;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-n games]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int c;
+  while ((c = getopt(argc, argv, "n:")) != -1)
+    switch (c)
+    {
+    case 'n':
+      games = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+    }
+
+  if (optind != argc || games < 1)
+    usage(argv[0]);
+
+  // Stan gry jest trzymany w zmiennych lokalnych dla wątku, więc wątek potrzebuje większego stosu
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+  MUST_INIT(!pthread_create(&thread, &attr, worker, NULL), "thread");
+  pthread_join(thread, NULL);
+  pthread_attr_destroy(&attr);
+
+  printf("%d games, %d failures\n", games, failures);
+  return failures > 0;
+}
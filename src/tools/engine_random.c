@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../rng.h"
+
+/**
+ * Przykładowy silnik (zob. `engine.h`) wybierający losowy możliwy ruch, bez podwładnego albo z podwładnym
+ * na pierwszej możliwej pozycji. Nie śledzi stanu planszy. Służy do sprawdzenia protokołu i zmierzenia jego
+ * narzutu. Przykład: tournament -b bot,engine -e bin/engine_random
+ */
+
+int main()
+{
+  Rng rng;
+  rng_seed(&rng, 1);
+
+  char *line = NULL;
+  size_t size = 0;
+  while (getline(&line, &size, stdin) > 0)
+  {
+    if (!strncmp(line, "carcassonne", 11))
+      printf("ready random\n");
+    else if (!strncmp(line, "quit", 4))
+      break;
+    else if (!strncmp(line, "go ", 3))
+    {
+      char *p = line + 3;
+      unsigned long id = strtoul(p, &p, 10);
+      strtol(p, &p, 10); // płytka
+      strtol(p, &p, 10); // limit czasu
+      int count = strtol(p, &p, 10);
+      int pick = count > 0 ? (int)rng_below(&rng, count) : 0;
+
+      long move[4] = {0};
+      for (int i = 0; i <= pick && i < count; i++)
+        for (int j = 0; j < 4; j++)
+          move[j] = strtol(p, &p, 10);
+
+      int meeple = -1;
+      if (move[3] && rng_below(&rng, 2))
+        meeple = __builtin_ctzl(move[3]);
+
+      printf("play %lu %ld %ld %ld %d\n", id, move[0], move[1], move[2], meeple);
+    }
+    else
+      continue;
+
+    fflush(stdout);
+  }
+
+  free(line);
+  return 0;
+}
@@ -0,0 +1,586 @@
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../bot.h"
+#include "../match.h"
+#include "../utils.h"
+
+/**
+ * Serwer gier
+ * Prowadzi wiele niezależnych gier naraz, bez okna. Gracze łączą się przez gniazdo Unix albo TCP na 127.0.0.1
+ * i rozmawiają z serwerem protokołem tekstowym (jedna komenda w linii). Wszystkie połączenia są obsługiwane
+ * przez kilka wątków z epoll. Przykład: server -u /tmp/carcassonne.sock -j 4
+ *
+ * Komendy klienta:
+ *   NEW gracze boty      - tworzy grę i dołącza do niej (odpowiedź: GAME id, SEAT miejsce)
+ *   JOIN id              - dołącza do gry, która jeszcze się nie zaczęła (odpowiedź: SEAT miejsce)
+ *   MOVE x y rot meeple  - ruch obecnego gracza: pozycja, liczba obrotów płytki (0-3) i pozycja podwładnego
+ *                          na płytce (0-12, -1 - bez podwładnego). Niepoprawny ruch: ERR, gracz próbuje dalej
+ *   QUIT                 - rozłącza. Miejsce gracza w trwającej grze przejmuje bot
+ *
+ * Komunikaty serwera (do wszystkich graczy przy stole):
+ *   START gracze ziarno  - wszyscy gracze dołączyli
+ *   TILE miejsce płytka  - gracz wylosował płytkę (numer bitmapy, jak w zapisie gry)
+ *   SKIP miejsce         - płytki nie da się nigdzie położyć
+ *   MOVE miejsce x y rot meeple
+ *   POINTS p0 p1 ...     - punkty po ruchu
+ *   LEFT miejsce         - gracz się rozłączył
+ *   END p0 p1 ...        - koniec gry i końcowe punkty
+ */
+
+#define THREAD_STACK_SIZE (16 << 20)
+#define LINE_SIZE 128
+#define MAX_EVENTS 64
+
+static struct Options
+{
+  const char *path;
+  int port, threads, games;
+  uint64_t seed;
+} opts = {.path = NULL, .port = 0, .threads = 1, .games = 256, .seed = 0};
+
+// Connections and games
+
+typedef struct Connection
+{
+  int fd;
+  char in[LINE_SIZE];
+  int in_len;
+  /**
+   * Gra i miejsce przy stole. -1 - gracz nie jest w żadnej grze. Oba pola są zmieniane tylko pod blokadą gry,
+   * a gra może się zakończyć w innym wątku, więc po zablokowaniu gry trzeba sprawdzić, czy gracz wciąż w niej jest
+   */
+  atomic_int game;
+  int seat;
+} Connection;
+
+/**
+ * Jedna gra. Stan gry jest zmieniany i wiadomości do jej graczy są wysyłane tylko pod blokadą gry,
+ * więc gracze jednej gry mogą być obsługiwani przez różne wątki
+ */
+typedef struct Game
+{
+  pthread_mutex_t lock;
+  bool used, started;
+  int humans, joined;
+  uint64_t seed;
+  Connection *seats[MEEPLE_COLOR_COUNT];
+  GameState state;
+} Game;
+
+/** Gry są tworzone przy pierwszym użyciu miejsca w tabeli i używane ponownie po zakończeniu */
+static struct Games
+{
+  pthread_mutex_t lock;
+  Game **items;
+  Rng rng;
+} games = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static int listen_fd;
+
+/**
+ * Wysyła jedną linię. Gracz, który nie odbiera wiadomości (pełny bufor gniazda), jest rozłączany -
+ * jego wątek dostanie koniec połączenia i posprząta po nim
+ */
+static void conn_send(Connection *c, const char *fmt, ...)
+{
+  char line[LINE_SIZE];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(line, sizeof(line) - 1, fmt, args);
+  va_end(args);
+  if (len > (int)sizeof(line) - 2)
+    len = sizeof(line) - 2;
+  line[len++] = '\n';
+
+  if (send(c->fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len)
+    shutdown(c->fd, SHUT_RDWR);
+}
+
+#define BROADCAST(G, ...)                                                                                              \
+  for (int _i = 0; _i < MEEPLE_COLOR_COUNT; _i++)                                                                      \
+    if ((G)->seats[_i])                                                                                                \
+  conn_send((G)->seats[_i], __VA_ARGS__)
+
+static void broadcast_points(Game *g, const char *cmd)
+{
+  char line[LINE_SIZE];
+  int len = sprintf(line, "%s", cmd);
+  for (int i = 0; i < match.count; i++)
+    len += sprintf(line + len, " %u", match.players[i].points);
+
+  BROADCAST(g, "%s", line);
+}
+
+/** Zwalnia miejsce gry w tabeli. Wywoływane pod blokadą gry */
+static void game_release(Game *g)
+{
+  for (int i = 0; i < MEEPLE_COLOR_COUNT; i++)
+    if (g->seats[i])
+    {
+      g->seats[i]->game = -1;
+      g->seats[i] = NULL;
+    }
+
+  g->used = false;
+}
+
+/**
+ * Rozgrywa ruchy botów i pominięte ruchy aż do ruchu gracza albo końca gry. Rozpoczęty ruch gracza, którego
+ * miejsce przejął bot, jest dokończony przez bota. Wywoływane pod blokadą gry
+ */
+static void game_advance(Game *g)
+{
+  Turn *turn = &match.turn;
+  while (!match.finished)
+  {
+    bool valid;
+    if (turn->active)
+      valid = board_tile_valid(&turn->tile);
+    else
+    {
+      valid = match_turn_start();
+      BROADCAST(g, "TILE %d %d", match.index, turn->tile.bitmap);
+    }
+
+    if (!valid)
+    {
+      turn->skip = true;
+      BROADCAST(g, "SKIP %d", match.index);
+    }
+    else if (match_current()->bot)
+    {
+      bot_turn(match_current(), turn, deck_size() / match.count, &match.rng);
+      BROADCAST(g, "MOVE %d %d %d %d %d", match.index, turn->x, turn->y, turn->tile.rot,
+                turn->meeple.color == MeepleNone ? -1 : turn->meeple.pos);
+    }
+    else
+      return;
+
+    match_turn_end();
+    if (valid && !match.finished)
+      broadcast_points(g, "POINTS");
+  }
+
+  if (match.finished)
+  {
+    broadcast_points(g, "END");
+    game_release(g);
+  }
+}
+
+/** Sprawdza ruch gracza tymi samymi zasadami co gra w oknie i go wykonuje. Wywoływane pod blokadą gry */
+static bool game_move(Game *g, int seat, int x, int y, int rot, int meeple)
+{
+  Turn *turn = &match.turn;
+  if (!g->started || !turn->active || match.index != seat)
+    return false;
+  if (x < 1 || x >= BOARD_SIZE || y < 1 || y >= BOARD_SIZE || rot < 0 || rot > 3 || meeple < -1 || meeple > TilePosCC)
+    return false;
+
+  Tile tile = turn->tile;
+  for (int i = 0; i < rot; i++)
+    tile_rotate(&tile);
+  if (!board_tile_matches(&tile, x, y))
+    return false;
+
+  Meeple m = {.color = match_current()->color, .pos = meeple < 0 ? TilePosCC : meeple};
+  if (meeple >= 0)
+  {
+    if (match_current()->meeple == 0)
+      return false;
+
+    MeepleValidPos valid;
+    board_tile_tmp(&tile, x, y);
+    board_meeple_valid(&m, x, y, valid);
+    board_tile_tmp(NULL, x, y);
+    if (!valid[meeple])
+      return false;
+  }
+  else
+    m.color = MeepleNone;
+
+  turn->tile = tile;
+  turn->x = x;
+  turn->y = y;
+  turn->meeple = m;
+  BROADCAST(g, "MOVE %d %d %d %d %d", seat, x, y, rot, meeple);
+
+  match_turn_end();
+  if (!match.finished)
+    broadcast_points(g, "POINTS");
+  game_advance(g);
+  return true;
+}
+
+/** Dołącza gracza do gry, a gdy są już wszyscy, zaczyna grę. Wywoływane pod blokadą gry */
+static bool game_join(Game *g, int id, Connection *c)
+{
+  if (!g->used || g->started || g->joined == g->humans)
+    return false;
+
+  c->game = id;
+  c->seat = g->joined++;
+  g->seats[c->seat] = c;
+  conn_send(c, "SEAT %d", c->seat);
+
+  if (g->joined == g->humans)
+  {
+    g->started = true;
+    BROADCAST(g, "START %d %llu", match.count, (unsigned long long)g->seed);
+    game_advance(g);
+  }
+
+  return true;
+}
+
+/** Blokuje grę i ustawia jej stan jako stan obecnego wątku */
+static Game *game_lock(int id)
+{
+  Game *g = games.items[id];
+  pthread_mutex_lock(&g->lock);
+  game_state_use(&g->state);
+  return g;
+}
+
+static void game_unlock(Game *g)
+{
+  game_state_use(NULL);
+  pthread_mutex_unlock(&g->lock);
+}
+
+/** Blokuje grę, w której jest gracz. NULL, jeżeli gracz nie jest w żadnej grze */
+static Game *conn_game_lock(Connection *c)
+{
+  int id = atomic_load(&c->game);
+  if (id < 0)
+    return NULL;
+
+  Game *g = game_lock(id);
+  if (atomic_load(&c->game) == id)
+    return g;
+
+  game_unlock(g);
+  return NULL;
+}
+
+static void cmd_new(Connection *c, int humans, int bots)
+{
+  if (humans < 1 || bots < 0 || humans + bots < 2 || humans + bots > MEEPLE_COLOR_COUNT)
+  {
+    conn_send(c, "ERR invalid players");
+    return;
+  }
+
+  // Znaleziona gra zostaje zablokowana, żeby nikt nie dołączył do niej przed `match_init()`
+  Game *g = NULL;
+  int id = 0;
+  pthread_mutex_lock(&games.lock);
+  for (; id < opts.games && !g; id++)
+  {
+    if (!games.items[id])
+    {
+      games.items[id] = calloc(1, sizeof(Game));
+      MUST_INIT(games.items[id], "game");
+      pthread_mutex_init(&games.items[id]->lock, NULL);
+    }
+
+    g = game_lock(id);
+    if (g->used)
+    {
+      game_unlock(g);
+      g = NULL;
+    }
+  }
+  uint64_t seed = rng_next(&games.rng);
+  pthread_mutex_unlock(&games.lock);
+
+  if (!g)
+  {
+    conn_send(c, "ERR server full");
+    return;
+  }
+
+  id--;
+  g->used = true;
+  g->started = false;
+  g->humans = humans;
+  g->joined = 0;
+  g->seed = seed;
+  match_init(humans, bots, g->seed, NULL);
+  conn_send(c, "GAME %d", id);
+  game_join(g, id, c);
+  game_unlock(g);
+}
+
+static void cmd_join(Connection *c, int id)
+{
+  pthread_mutex_lock(&games.lock);
+  bool exists = id >= 0 && id < opts.games && games.items[id];
+  pthread_mutex_unlock(&games.lock);
+
+  if (!exists)
+  {
+    conn_send(c, "ERR no such game");
+    return;
+  }
+
+  Game *g = game_lock(id);
+  if (!game_join(g, id, c))
+    conn_send(c, "ERR cannot join");
+  game_unlock(g);
+}
+
+/** Gracz opuszcza grę. W trwającej grze jego miejsce przejmuje bot, a gra bez graczy jest kończona */
+static void conn_leave(Connection *c)
+{
+  Game *g = conn_game_lock(c);
+  if (!g)
+    return;
+
+  g->seats[c->seat] = NULL;
+  c->game = -1;
+
+  bool empty = true;
+  for (int i = 0; i < MEEPLE_COLOR_COUNT; i++)
+    if (g->seats[i])
+      empty = false;
+
+  if (empty)
+    game_release(g);
+  else if (!g->started)
+  {
+    // Przed rozpoczęciem gry pozostali gracze przesuwają się na wolne miejsce
+    for (int i = c->seat; i + 1 < g->joined; i++)
+      if ((g->seats[i] = g->seats[i + 1]))
+        g->seats[i]->seat = i;
+    g->seats[--g->joined] = NULL;
+  }
+  else
+  {
+    match.players[c->seat].bot = true;
+    BROADCAST(g, "LEFT %d", c->seat);
+    game_advance(g);
+  }
+
+  game_unlock(g);
+}
+
+/** Wykonuje jedną linię od klienta. Zwraca false, jeżeli połączenie trzeba zamknąć */
+static bool conn_command(Connection *c, char *line)
+{
+  // Odpowiedzi dla gracza w grze są wysyłane pod blokadą gry, żeby nie przeplatały się z wiadomościami innych wątków
+  int a, b, x, y;
+  Game *g;
+  if (sscanf(line, "MOVE %d %d %d %d", &x, &y, &a, &b) == 4)
+  {
+    if (!(g = conn_game_lock(c)))
+      conn_send(c, "ERR not in game");
+    else
+    {
+      if (!game_move(g, c->seat, x, y, a, b))
+        conn_send(c, "ERR invalid move");
+      game_unlock(g);
+    }
+  }
+  else if (sscanf(line, "NEW %d %d", &a, &b) == 2 || sscanf(line, "JOIN %d", &a) == 1)
+  {
+    if ((g = conn_game_lock(c)))
+    {
+      conn_send(c, "ERR already in game");
+      game_unlock(g);
+    }
+    else if (line[0] == 'N')
+      cmd_new(c, a, b);
+    else
+      cmd_join(c, a);
+  }
+  else if (!strcmp(line, "QUIT"))
+    return false;
+  else
+    conn_send(c, "ERR unknown command");
+
+  return true;
+}
+
+/** Czyta dane z gniazda i wykonuje wszystkie pełne linie. Zwraca false, jeżeli połączenie trzeba zamknąć */
+static bool conn_read(Connection *c)
+{
+  ssize_t n = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+  if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    return true;
+  if (n <= 0)
+    return false;
+
+  c->in_len += n;
+  char *start = c->in, *end;
+  while ((end = memchr(start, '\n', c->in + c->in_len - start)))
+  {
+    *end = '\0';
+    if (end > start && end[-1] == '\r')
+      end[-1] = '\0';
+    if (!conn_command(c, start))
+      return false;
+    start = end + 1;
+  }
+
+  c->in_len -= start - c->in;
+  memmove(c->in, start, c->in_len);
+
+  // Linia dłuższa niż bufor nie jest poprawną komendą
+  return c->in_len < (int)sizeof(c->in);
+}
+
+static void conn_close(Connection *c)
+{
+  conn_leave(c);
+  close(c->fd);
+  free(c);
+}
+
+// Workers
+
+/**
+ * Każdy wątek ma własny epoll z gniazdem nasłuchującym (EPOLLEXCLUSIVE - połączenie przyjmuje jeden wątek)
+ * i obsługuje wszystkie połączenia, które przyjął
+ */
+static void *worker(void *arg)
+{
+  UNUSED(arg);
+
+  int epfd = epoll_create1(0);
+  MUST_INIT((epfd >= 0), "epoll");
+
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL};
+  MUST_INIT(!epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev), "epoll");
+
+  struct epoll_event events[MAX_EVENTS];
+  for (;;)
+  {
+    int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+    for (int i = 0; i < n; i++)
+    {
+      Connection *c = events[i].data.ptr;
+      if (!c)
+      {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+          continue;
+
+        c = calloc(1, sizeof(Connection));
+        MUST_INIT(c, "connection");
+        c->fd = fd;
+        c->game = -1;
+
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = c;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev))
+          conn_close(c);
+      }
+      else if (!conn_read(c) || events[i].events & (EPOLLHUP | EPOLLERR))
+        conn_close(c);
+    }
+  }
+
+  return NULL;
+}
+
+static int listen_unix(const char *path)
+{
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  ASSERTF((strlen(path) < sizeof(addr.sun_path)), "Socket path too long.");
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  MUST_INIT((fd >= 0 && !bind(fd, (struct sockaddr *)&addr, sizeof(addr))), "socket");
+  return fd;
+}
+
+static int listen_tcp(int port)
+{
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), one = 1;
+  MUST_INIT((fd >= 0), "socket");
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  MUST_INIT(!bind(fd, (struct sockaddr *)&addr, sizeof(addr)), "socket");
+  return fd;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s (-u socket_path | -p port) [-j threads] [-g max_games] [-s seed]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  opts.seed = time(NULL);
+
+  int c;
+  while ((c = getopt(argc, argv, "u:p:j:g:s:")) != -1)
+    switch (c)
+    {
+    case 'u':
+      opts.path = optarg;
+      break;
+    case 'p':
+      opts.port = atoi(optarg);
+      break;
+    case 'j':
+      opts.threads = atoi(optarg);
+      break;
+    case 'g':
+      opts.games = atoi(optarg);
+      break;
+    case 's':
+      opts.seed = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      usage(argv[0]);
+    }
+
+  if (optind != argc || !opts.path == !opts.port || opts.threads < 1 || opts.games < 1)
+    usage(argv[0]);
+
+  rng_seed(&games.rng, opts.seed);
+  games.items = calloc(opts.games, sizeof(Game *));
+  MUST_INIT(games.items, "games");
+
+  listen_fd = opts.path ? listen_unix(opts.path) : listen_tcp(opts.port);
+  MUST_INIT(!listen(listen_fd, SOMAXCONN), "listen");
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+
+  pthread_t *threads = malloc(opts.threads * sizeof(pthread_t));
+  MUST_INIT(threads, "threads");
+  for (int i = 0; i < opts.threads; i++)
+    MUST_INIT(!pthread_create(&threads[i], &attr, worker, NULL), "thread");
+
+  if (opts.path)
+    fprintf(stderr, "listening on %s with %d threads\n", opts.path, opts.threads);
+  else
+    fprintf(stderr, "listening on 127.0.0.1:%d with %d threads\n", opts.port, opts.threads);
+
+  for (int i = 0; i < opts.threads; i++)
+    pthread_join(threads[i], NULL);
+
+  return 0;
+}
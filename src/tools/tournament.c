@@ -0,0 +1,256 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../sim.h"
+#include "../utils.h"
+
+/**
+ * Turniej botów
+ * Rozgrywa wiele gier bez okna w kilku wątkach i wypisuje statystyki dla każdego miejsca przy stole
+ * w formacie JSON albo CSV. Przykład: tournament -n 1000 -p 3 -b bot,random,random -j 8 -f csv
+ */
+
+static const char *BOT_NAMES[BotKindCount] = {"bot", "random", "engine"};
+
+static struct Options
+{
+  int games, threads;
+  uint64_t seed;
+  bool csv;
+  const char *output, *stats, *aggregate, *replay, *start;
+  SimConfig sim;
+} opts = {.games = 100, .threads = 1, .seed = 0, .csv = false, .output = NULL, .stats = NULL, .aggregate = NULL,
+          .replay = NULL, .start = NULL, .sim = {.players = 2, .engine = NULL, .engine_ms = 1000}};
+
+/** Pozycja, od której zaczynają się wszystkie gry (opcja -i) */
+static Snapshot start;
+
+/** Statystyki wszystkich gier, zbierane na bieżąco */
+static GameStats game_stats;
+static SimBatch batch;
+
+// Statistics
+
+typedef struct SeatStats
+{
+  double wins;
+  double score_mean, score_std;
+  int score_min, score_p50, score_max;
+  int moves;
+  double move_ms_mean, move_ms_p99;
+} SeatStats;
+
+static void seat_stats(int seat, SeatStats *s)
+{
+  const StatsHist *h = &game_stats.score[seat];
+  const StatsSketch *m = &game_stats.move_ms[seat];
+
+  s->wins = batch.wins[seat];
+  s->score_mean = stats_hist_mean(h, &s->score_std);
+  s->score_min = stats_hist_quantile(h, 0);
+  s->score_p50 = stats_hist_quantile(h, 0.5);
+  s->score_max = stats_hist_quantile(h, 1);
+  s->moves = m->count;
+  s->move_ms_mean = m->count ? m->sum / m->count : 0;
+  s->move_ms_p99 = stats_sketch_quantile(m, 0.99);
+}
+
+// Output
+
+static void print_json(FILE *f, double wall)
+{
+  fprintf(f, "{\"games\":%d,\"players\":%d,\"threads\":%d,\"seed\":%" PRIu64 ",\"wall_s\":%.3f,\"games_per_s\":%.2f,",
+          opts.games, opts.sim.players, opts.threads, opts.seed, wall, opts.games / wall);
+  fprintf(f, "\"seats\":[");
+
+  for (int i = 0; i < opts.sim.players; i++)
+  {
+    SeatStats s;
+    seat_stats(i, &s);
+    fprintf(f,
+            "%s{\"seat\":%d,\"bot\":\"%s\",\"win_rate\":%.4f,\"score_mean\":%.2f,\"score_std\":%.2f,"
+            "\"score_min\":%d,\"score_p50\":%d,\"score_max\":%d,\"moves\":%d,\"move_ms_mean\":%.3f,"
+            "\"move_ms_p99\":%.3f}",
+            i ? "," : "", i, BOT_NAMES[opts.sim.bots[i]], s.wins / opts.games, s.score_mean, s.score_std,
+            s.score_min, s.score_p50, s.score_max, s.moves, s.move_ms_mean, s.move_ms_p99);
+  }
+
+  fprintf(f, "]}\n");
+}
+
+static void print_csv(FILE *f, double wall)
+{
+  fprintf(f, "seat,bot,games,win_rate,score_mean,score_std,score_min,score_p50,score_max,moves,move_ms_mean,"
+             "move_ms_p99,wall_s,games_per_s\n");
+
+  for (int i = 0; i < opts.sim.players; i++)
+  {
+    SeatStats s;
+    seat_stats(i, &s);
+    fprintf(f, "%d,%s,%d,%.4f,%.2f,%.2f,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.2f\n", i, BOT_NAMES[opts.sim.bots[i]],
+            opts.games, s.wins / opts.games, s.score_mean, s.score_std, s.score_min, s.score_p50, s.score_max,
+            s.moves, s.move_ms_mean, s.move_ms_p99, wall, opts.games / wall);
+  }
+}
+
+// Options
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [-n games] [-p players] [-b bot,random,...] [-j threads] [-s seed] [-f json|csv] [-o file]"
+          " [-r replay_file] [-i snapshot_file] [-e engine_command] [-t engine_ms] [-a stats_json]"
+#ifdef BOT_STATS
+          " [-l stats_file]"
+#endif
+          "\n",
+          name);
+  exit(1);
+}
+
+static void parse_bots(char *list)
+{
+  int i = 0;
+  for (char *name = strtok(list, ","); name; name = strtok(NULL, ","), i++)
+  {
+    ASSERTF((i < MEEPLE_COLOR_COUNT), "Too many bots.");
+
+    int kind = 0;
+    while (kind < BotKindCount && strcmp(name, BOT_NAMES[kind]))
+      kind++;
+    ASSERTF((kind < BotKindCount), "Unknown bot '%s'.", name);
+
+    opts.sim.bots[i] = kind;
+  }
+
+  // Pozostałe miejsca zajmuje ostatni podany bot
+  for (; i > 0 && i < MEEPLE_COLOR_COUNT; i++)
+    opts.sim.bots[i] = opts.sim.bots[i - 1];
+}
+
+static void parse_options(int argc, char **argv)
+{
+  int c;
+  while ((c = getopt(argc, argv, "n:p:b:j:s:f:o:r:i:e:t:a:l:")) != -1)
+    switch (c)
+    {
+    case 'n':
+      opts.games = atoi(optarg);
+      break;
+    case 'p':
+      opts.sim.players = atoi(optarg);
+      break;
+    case 'b':
+      parse_bots(optarg);
+      break;
+    case 'j':
+      opts.threads = atoi(optarg);
+      break;
+    case 's':
+      opts.seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'f':
+      if (strcmp(optarg, "csv") && strcmp(optarg, "json"))
+        usage(argv[0]);
+      opts.csv = !strcmp(optarg, "csv");
+      break;
+    case 'o':
+      opts.output = optarg;
+      break;
+    case 'r':
+      opts.replay = optarg;
+      break;
+    case 'i':
+      opts.start = optarg;
+      break;
+    case 'e':
+      opts.sim.engine = optarg;
+      break;
+    case 't':
+      opts.sim.engine_ms = atoi(optarg);
+      break;
+    case 'a':
+      opts.aggregate = optarg;
+      break;
+#ifdef BOT_STATS
+    case 'l':
+      opts.stats = optarg;
+      break;
+#endif
+    default:
+      usage(argv[0]);
+    }
+
+  // Liczba graczy wynika z wczytanej pozycji
+  if (opts.start)
+  {
+    FILE *f = fopen(opts.start, "rb");
+    MUST_INIT((f && snapshot_read(&start, f)), "snapshot");
+    fclose(f);
+    opts.sim.start = &start;
+    opts.sim.players = start.state.m.count;
+  }
+
+  if (opts.games < 1 || opts.threads < 1 || opts.sim.players < 2 || opts.sim.players > MEEPLE_COLOR_COUNT)
+    usage(argv[0]);
+
+  for (int i = 0; i < opts.sim.players; i++)
+    if (opts.sim.bots[i] == BotKindEngine && !opts.sim.engine)
+      usage(argv[0]);
+}
+
+int main(int argc, char **argv)
+{
+  parse_options(argc, argv);
+
+  opts.sim.stats = &game_stats;
+
+  // Zapisy gier są dopisywane w kolejności ich zakończenia
+  if (opts.replay)
+    MUST_INIT((opts.sim.replay = fopen(opts.replay, "ab")), "replay file");
+
+#ifdef BOT_STATS
+  // Statystyki każdej tury bota, jedna linia JSON na turę
+  FILE *stats = opts.stats ? fopen(opts.stats, "w") : NULL;
+  MUST_INIT((stats || !opts.stats), "stats file");
+  bot_stats_log(stats);
+#endif
+
+  batch = sim_run_batch(&opts.sim, opts.games, opts.threads, opts.seed, NULL);
+  double wall = batch.wall_s;
+
+  FILE *f = opts.output ? fopen(opts.output, "w") : stdout;
+  MUST_INIT(f, "output file");
+
+  if (opts.csv)
+    print_csv(f, wall);
+  else
+    print_json(f, wall);
+
+  if (f != stdout)
+    fclose(f);
+
+  // Pełne statystyki: punkty według typu obiektu, podwładni, płytki
+  if (opts.aggregate)
+  {
+    FILE *a = fopen(opts.aggregate, "w");
+    MUST_INIT(a, "aggregate stats file");
+    stats_write_json(&game_stats, opts.sim.players, a);
+    fclose(a);
+  }
+
+  for (int i = 0; i < opts.sim.players; i++)
+    if (opts.sim.bots[i] == BotKindEngine && batch.engine_errors[i])
+      fprintf(stderr, "seat %d: %d engine errors\n", i, batch.engine_errors[i]);
+  if (opts.sim.replay)
+    fclose(opts.sim.replay);
+
+#ifdef BOT_STATS
+  if (stats)
+    fclose(stats);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../deck.h"
+#include "../match.h"
+#include "../utils.h"
+
+/**
+ * Sprawdzanie zapisów gier
+ * Rozgrywa ponownie wszystkie gry z pliku zapisów (bez wyświetlania i bez botów) i porównuje końcowe punkty
+ * z zapisanymi. Służy do sprawdzenia, czy zmiany w zasadach lub optymalizacje nie zmieniły wyników gier.
+ * Przykład: verify -j 8 gry.bin
+ */
+
+#define THREAD_STACK_SIZE (16 << 20)
+/** Liczba gier pobieranych naraz przez wątek */
+#define CHUNK_SIZE 256
+
+static struct Archive
+{
+  const uint8_t *data;
+  size_t size;
+  /** Początki kolejnych gier w pliku */
+  size_t *offsets;
+  int count;
+} archive;
+
+static atomic_int next_chunk;
+static atomic_int divergences;
+static int max_reports = 20;
+
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Wypisuje rozbieżność. Wypisywanych jest co najwyżej `max_reports` pierwszych rozbieżności */
+static void report(int game, size_t offset, const char *fmt, ...)
+{
+  if (atomic_fetch_add(&divergences, 1) >= max_reports)
+    return;
+
+  va_list args;
+  va_start(args, fmt);
+  pthread_mutex_lock(&report_lock);
+  printf("game %d (offset %zu): ", game, offset);
+  vprintf(fmt, args);
+  printf("\n");
+  pthread_mutex_unlock(&report_lock);
+  va_end(args);
+}
+
+static void verify_game(int idx)
+{
+  ReplayGame game;
+  size_t offset = archive.offsets[idx];
+  replay_decode(archive.data + offset, archive.size - offset, &game);
+
+  int bots = __builtin_popcount(game.bots);
+  match_init(game.players - bots, bots, game.seed, NULL);
+
+  for (int i = 0; i < game.turn_count; i++)
+    if (!match_turn_replay(game.turns[i]))
+    {
+      report(idx, offset, "turn %d of %d does not match the game state", i, game.turn_count);
+      return;
+    }
+
+  if (!match.finished)
+  {
+    report(idx, offset, "game ends after %d turns, but the deck has %d tiles left", game.turn_count, deck_size());
+    return;
+  }
+
+  for (int i = 0; i < game.players; i++)
+    if (match.players[i].points != game.points[i])
+    {
+      report(idx, offset, "player %d has %u points, expected %d", i, match.players[i].points, game.points[i]);
+      return;
+    }
+}
+
+static void *worker(void *arg)
+{
+  UNUSED(arg);
+
+  for (int chunk; (chunk = atomic_fetch_add(&next_chunk, 1)) * CHUNK_SIZE < archive.count;)
+  {
+    int end = (chunk + 1) * CHUNK_SIZE < archive.count ? (chunk + 1) * CHUNK_SIZE : archive.count;
+    for (int i = chunk * CHUNK_SIZE; i < end; i++)
+      verify_game(i);
+  }
+
+  return NULL;
+}
+
+/** Wyszukuje początki gier. Zwraca false, jeżeli plik jest uszkodzony */
+static bool archive_index()
+{
+  size_t capacity = 1024, offset = 0;
+  archive.offsets = malloc(capacity * sizeof(size_t));
+  MUST_INIT(archive.offsets, "index");
+
+  while (offset < archive.size)
+  {
+    ReplayGame game;
+    size_t size = replay_decode(archive.data + offset, archive.size - offset, &game);
+    if (!size)
+    {
+      fprintf(stderr, "invalid game at offset %zu\n", offset);
+      return false;
+    }
+
+    if ((size_t)archive.count == capacity)
+    {
+      capacity *= 2;
+      archive.offsets = realloc(archive.offsets, capacity * sizeof(size_t));
+      MUST_INIT(archive.offsets, "index");
+    }
+
+    archive.offsets[archive.count++] = offset;
+    offset += size;
+  }
+
+  return true;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-j threads] [-m max_reports] replay_file\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int c, threads_count = 1;
+  while ((c = getopt(argc, argv, "j:m:")) != -1)
+    switch (c)
+    {
+    case 'j':
+      threads_count = atoi(optarg);
+      break;
+    case 'm':
+      max_reports = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+    }
+
+  if (optind != argc - 1 || threads_count < 1)
+    usage(argv[0]);
+
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  MUST_INIT((fd >= 0 && !fstat(fd, &st)), "replay file");
+
+  archive.size = st.st_size;
+  if (archive.size > 0)
+  {
+    archive.data = mmap(NULL, archive.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    MUST_INIT((archive.data != MAP_FAILED), "mmap");
+    madvise((void *)archive.data, archive.size, MADV_SEQUENTIAL);
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  bool valid = archive_index();
+
+  pthread_t *threads = malloc(threads_count * sizeof(pthread_t));
+  MUST_INIT(threads, "threads");
+
+  // Stan gry jest trzymany w zmiennych lokalnych dla wątku, więc wątki potrzebują większego stosu
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+
+  for (int i = 0; i < threads_count; i++)
+    MUST_INIT(!pthread_create(&threads[i], &attr, worker, NULL), "thread");
+  for (int i = 0; i < threads_count; i++)
+    pthread_join(threads[i], NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  int diverged = atomic_load(&divergences);
+  printf("%d games, %d diverged, %.3f s, %.0f games/s\n", archive.count, diverged, wall, archive.count / wall);
+
+  pthread_attr_destroy(&attr);
+  free(threads);
+  free(archive.offsets);
+  if (archive.size > 0)
+    munmap((void *)archive.data, archive.size);
+  close(fd);
+
+  return diverged || !valid;
+}
@@ -21,6 +21,13 @@
 
 #define MUST_INIT(E, M) ASSERTF(E, "Couldn't initialize %s.", M)
 
+/** Kod zbierający statystyki, kompilowany tylko z flagą -DBOT_STATS (`make stats`) */
+#ifdef BOT_STATS
+#define STATS(X) X
+#else
+#define STATS(X)
+#endif
+
 // clang-format off
 #define UNUSED(x) (void)(x)
 #define UNUSED2(x1,x2) UNUSED(x1); UNUSED(x2)